@@ -0,0 +1,154 @@
+#version 120
+
+varying vec3 var_V;
+varying vec3 var_L;
+
+struct scm
+{
+    vec2  r;
+    vec2  b[16];
+    float a[16];
+    float k0;
+    float k1;
+};
+
+uniform sampler2D scalar_sampler;
+uniform sampler2D height_sampler;
+
+uniform scm scalar;
+uniform scm height;
+
+uniform mat3 M;
+uniform vec2 A[16];
+uniform vec2 B[16];
+
+//------------------------------------------------------------------------------
+
+vec4 sample_scalar(vec2 t)
+{
+    vec4   c = texture2D(scalar_sampler, (t * A[ 0] + B[ 0]) * scalar.r + scalar.b[ 0]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 1] + B[ 1]) * scalar.r + scalar.b[ 1]), scalar.a[ 1]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 2] + B[ 2]) * scalar.r + scalar.b[ 2]), scalar.a[ 2]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 3] + B[ 3]) * scalar.r + scalar.b[ 3]), scalar.a[ 3]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 4] + B[ 4]) * scalar.r + scalar.b[ 4]), scalar.a[ 4]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 5] + B[ 5]) * scalar.r + scalar.b[ 5]), scalar.a[ 5]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 6] + B[ 6]) * scalar.r + scalar.b[ 6]), scalar.a[ 6]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 7] + B[ 7]) * scalar.r + scalar.b[ 7]), scalar.a[ 7]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 8] + B[ 8]) * scalar.r + scalar.b[ 8]), scalar.a[ 8]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[ 9] + B[ 9]) * scalar.r + scalar.b[ 9]), scalar.a[ 9]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[10] + B[10]) * scalar.r + scalar.b[10]), scalar.a[10]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[11] + B[11]) * scalar.r + scalar.b[11]), scalar.a[11]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[12] + B[12]) * scalar.r + scalar.b[12]), scalar.a[12]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[13] + B[13]) * scalar.r + scalar.b[13]), scalar.a[13]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[14] + B[14]) * scalar.r + scalar.b[14]), scalar.a[14]);
+    c = mix(c, texture2D(scalar_sampler, (t * A[15] + B[15]) * scalar.r + scalar.b[15]), scalar.a[15]);
+    return c;
+}
+
+vec4 sample_height(vec2 t)
+{
+    vec4   c = vec4(1.0);
+    c = mix(c, texture2D(height_sampler, (t * A[ 0] + B[ 0]) * height.r + height.b[ 0]), 1.0);
+    c = mix(c, texture2D(height_sampler, (t * A[ 1] + B[ 1]) * height.r + height.b[ 1]), height.a[ 1]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 2] + B[ 2]) * height.r + height.b[ 2]), height.a[ 2]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 3] + B[ 3]) * height.r + height.b[ 3]), height.a[ 3]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 4] + B[ 4]) * height.r + height.b[ 4]), height.a[ 4]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 5] + B[ 5]) * height.r + height.b[ 5]), height.a[ 5]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 6] + B[ 6]) * height.r + height.b[ 6]), height.a[ 6]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 7] + B[ 7]) * height.r + height.b[ 7]), height.a[ 7]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 8] + B[ 8]) * height.r + height.b[ 8]), height.a[ 8]);
+    c = mix(c, texture2D(height_sampler, (t * A[ 9] + B[ 9]) * height.r + height.b[ 9]), height.a[ 9]);
+    c = mix(c, texture2D(height_sampler, (t * A[10] + B[10]) * height.r + height.b[10]), height.a[10]);
+    c = mix(c, texture2D(height_sampler, (t * A[11] + B[11]) * height.r + height.b[11]), height.a[11]);
+    c = mix(c, texture2D(height_sampler, (t * A[12] + B[12]) * height.r + height.b[12]), height.a[12]);
+    c = mix(c, texture2D(height_sampler, (t * A[13] + B[13]) * height.r + height.b[13]), height.a[13]);
+    c = mix(c, texture2D(height_sampler, (t * A[14] + B[14]) * height.r + height.b[14]), height.a[14]);
+    c = mix(c, texture2D(height_sampler, (t * A[15] + B[15]) * height.r + height.b[15]), height.a[15]);
+    return c;
+}
+
+//------------------------------------------------------------------------------
+
+vec3 scube(vec2 t)
+{
+    vec2  s = radians(t * 90.0 - 45.0);
+
+    float x =  sin(s.x) * cos(s.y);
+    float y = -cos(s.x) * sin(s.y);
+    float z =  cos(s.x) * cos(s.y);
+
+    return M * normalize(vec3(x, y, z));
+}
+
+// Derive the surface normal from the height by central differences a fixed
+// 1/254 of the page apart. That is one texel of a 254-sample page, but only
+// about 0.7 texel of a 180-sample page such as MEGDR's, where the difference
+// falls between texels and relies on linear filtering. Height differences are
+// taken before denormalization, and the tangents are formed in units of
+// distance, so that the large radius and the small relief never meet in one
+// subtraction.
+
+const float texel = 1.0 / 254.0;
+
+vec3 derive_normal(vec2 t)
+{
+    vec2 dx = vec2(texel, 0.0);
+    vec2 dy = vec2(0.0, texel);
+
+    float k = height.k1 - height.k0;
+    float h = mix(height.k0, height.k1, sample_height(t).r);
+    vec3  n = scube(A[0] * t + B[0]);
+
+    vec3 u = (scube(A[0] * (t + dx) + B[0]) - scube(A[0] * (t - dx) + B[0])) * h;
+    vec3 v = (scube(A[0] * (t + dy) + B[0]) - scube(A[0] * (t - dy) + B[0])) * h;
+
+    u += n * k * (sample_height(t + dx).r - sample_height(t - dx).r);
+    v += n * k * (sample_height(t + dy).r - sample_height(t - dy).r);
+
+    vec3 N = normalize(cross(u, v));
+
+    return faceforward(N, -n, N);
+}
+
+//------------------------------------------------------------------------------
+
+float peak(float k, float c)
+{
+    return max(0.0, 1.0 - abs(k - c) * 5.0);
+}
+
+vec3 bound(vec3 c, float k)
+{
+    c = mix(c, vec3(1.0), step(1.0, k));
+    c = mix(c, vec3(0.2), step(k, 0.0));
+    return c;
+}
+
+vec3 colormap(float k)
+{
+    return bound(peak(k, 0.0) * vec3(1.0, 0.0, 1.0) +
+                 peak(k, 0.2) * vec3(0.0, 0.0, 1.0) +
+                 peak(k, 0.4) * vec3(0.0, 1.0, 1.0) +
+                 peak(k, 0.6) * vec3(1.0, 1.0, 0.0) +
+                 peak(k, 0.8) * vec3(1.0, 0.0, 0.0) +
+                 peak(k, 1.0) * vec3(1.0, 1.0, 1.0), k);
+}
+
+//------------------------------------------------------------------------------
+
+void main()
+{
+    vec3 V = normalize(var_V);
+    vec3 L = normalize(var_L);
+
+    vec4  S =           sample_scalar(gl_TexCoord[0].xy);
+    vec3  N =           derive_normal(gl_TexCoord[0].xy);
+
+    float k = mix(scalar.k0, scalar.k1, S.r);
+
+    float nl = max(0.0, dot(N, L));
+    float nv = max(0.0, dot(N, V));
+    float kd = 2.0 * nl / (nl + nv);
+
+    gl_FragColor = vec4(colormap(k) * kd, 1.0);
+}
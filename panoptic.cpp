@@ -11,8 +11,17 @@
 //  General Public License for more details.
 
 #include <SDL_mouse.h>
+#include <SDL_timer.h>
 
 #include <cmath>
+#include <ctime>
+#include <cstring>
+
+#include <stdint.h>
+
+#ifndef WIN32
+#include <sys/select.h>
+#endif
 
 #include <ogl-opengl.hpp>
 
@@ -40,7 +49,12 @@ panoptic::panoptic(const std::string& exe,
     demo_turn(0),
     demo_dist_delay(0),
     demo_turn_delay(0),
-    report_sock(INVALID_SOCKET)
+    path_active(false),
+    report_sock(INVALID_SOCKET),
+    sync_sock(INVALID_SOCKET),
+    sync_follow(false),
+    sync_session(0),
+    sync_frame(0)
 {
     // Initialize all interaction state.
 
@@ -60,10 +74,69 @@ panoptic::panoptic(const std::string& exe,
         if (init_sockaddr(report_addr, host.c_str(), port))
             report_sock = socket(AF_INET, SOCK_DGRAM, 0);
     }
+
+    // Initialize the state synchronization socket. A master sends its state
+    // to a range of ports on the sync host, which may be a broadcast address.
+    // A follower listens on the sync port.
+
+    int         sync_port  = ::conf->get_i("panoptic_sync_port", 8112);
+    int         sync_count = ::conf->get_i("panoptic_sync_count",   1);
+    std::string sync_host  = ::conf->get_s("panoptic_sync_host");
+
+    sync_follow = (::conf->get_i("panoptic_sync_follow", 0) != 0);
+    sync_lag    =  ::conf->get_i("panoptic_sync_lag",   30);
+
+    if (sync_port && sync_follow)
+    {
+        sockaddr_in addr;
+        int         one = 1;
+
+        memset(&addr, 0, sizeof (sockaddr_in));
+
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(sync_port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        if ((sync_sock = socket(AF_INET, SOCK_DGRAM, 0)) != INVALID_SOCKET)
+        {
+            setsockopt(sync_sock, SOL_SOCKET, SO_REUSEADDR,
+                       (const char *) &one, sizeof (one));
+
+            if (bind(sync_sock, (const sockaddr *) &addr, sizeof (addr)) < 0)
+            {
+                close(sync_sock);
+                sync_sock = INVALID_SOCKET;
+            }
+        }
+    }
+    else if (sync_port && !sync_host.empty())
+    {
+        sockaddr_in addr;
+        int         one = 1;
+
+        for (int i = 0; i < sync_count; i++)
+            if (init_sockaddr(addr, sync_host.c_str(), sync_port + i))
+                sync_addr.push_back(addr);
+
+        if (!sync_addr.empty())
+        {
+            if ((sync_sock = socket(AF_INET, SOCK_DGRAM, 0)) != INVALID_SOCKET)
+                setsockopt(sync_sock, SOL_SOCKET, SO_BROADCAST,
+                           (const char *) &one, sizeof (one));
+        }
+
+        // Distinguish this run from any earlier one. Zero means no session.
+
+        sync_session = uint32_t(time(0))
+                     ^ uint32_t(SDL_GetPerformanceCounter());
+        sync_session = sync_session ? sync_session : 1;
+    }
 }
 
 panoptic::~panoptic()
 {
+    if (sync_sock != INVALID_SOCKET)
+        close(sync_sock);
     if (report_sock != INVALID_SOCKET)
         close(report_sock);
 }
@@ -118,10 +191,249 @@ void panoptic::report()
 
 //------------------------------------------------------------------------------
 
+// The sync mechanism reproduces the master's view on any number of render
+// nodes. Once per frame the master sends a compact, quantized copy of its here
+// state tagged with a session and frame number. Followers apply the newest
+// state on their next tick, ahead of their own prep, and acknowledge its frame
+// number. A new session, as when the master restarts, resets the frame count.
+// Scenes are named, as each node instantiates them in its own order. Nodes are
+// assumed to share a byte order.
+
+struct sync_message
+{
+    uint32_t session;
+    uint32_t frame;
+    int16_t  q[4];                      // Orientation quaternion
+    int32_t  p[3];                      // Position unit vector
+    int16_t  l[3];                      // Light unit vector
+    char     s[4][32];                  // Scene names f0, f1, b0, b1
+    float    fade;
+    float    zoom;                      // Scene zoom
+    float    view_zoom;                 // Interactive zoom exponent
+    double   distance;
+};
+
+static int16_t quantize16(double k)
+{
+    return int16_t(floor(std::max(-1.0, std::min(k, 1.0)) * 32767.0 + 0.5));
+}
+
+static int32_t quantize32(double k)
+{
+    return int32_t(floor(std::max(-1.0, std::min(k, 1.0)) * 2147483647.0 + 0.5));
+}
+
+static void sync_normalize(double *v, int n)
+{
+    double d = 0.0;
+
+    for (int i = 0; i < n; i++) d += v[i] * v[i];
+
+    if ((d = sqrt(d)) > 0.0)
+        for (int i = 0; i < n; i++) v[i] /= d;
+}
+
+static unsigned long long sync_key(const sockaddr_in& addr)
+{
+    return ((unsigned long long) addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
+
+void panoptic::sync_send()
+{
+    if (sync_sock != INVALID_SOCKET && !sync_follow)
+    {
+        sync_message m;
+
+        memset(&m, 0, sizeof (m));
+
+        double q[4];
+        double p[3];
+        double l[3];
+
+        here.get_orientation(q);
+        here.get_position   (p);
+        here.get_light      (l);
+
+        m.session = sync_session;
+        m.frame   = ++sync_frame;
+
+        for (int i = 0; i < 4; i++) m.q[i] = quantize16(q[i]);
+        for (int i = 0; i < 3; i++) m.p[i] = quantize32(p[i]);
+        for (int i = 0; i < 3; i++) m.l[i] = quantize16(l[i]);
+
+        sync_put(m.s[0], here.get_foreground0());
+        sync_put(m.s[1], here.get_foreground1());
+        sync_put(m.s[2], here.get_background0());
+        sync_put(m.s[3], here.get_background1());
+
+        m.fade      = float(here.get_fade());
+        m.zoom      = float(here.get_zoom());
+        m.view_zoom = float(zoom);
+        m.distance  = here.get_distance();
+
+        for (size_t i = 0; i < sync_addr.size(); i++)
+            sendto(sync_sock, (const char *) &m, sizeof (m), 0,
+                   (const sockaddr *) &sync_addr[i], sizeof (sockaddr_in));
+
+        // Collect acknowledgements, noting the newest frame each follower has
+        // applied.
+
+        fd_set         fds;
+        struct timeval tv = { 0, 0 };
+        sockaddr_in    addr;
+        socklen_t      size = sizeof (sockaddr_in);
+        uint32_t       ack;
+
+        FD_ZERO(&fds);
+        FD_SET(sync_sock, &fds);
+
+        while (select(int(sync_sock) + 1, &fds, 0, 0, &tv) > 0)
+        {
+            if (recvfrom(sync_sock, (char *) &ack, sizeof (ack), 0,
+                         (sockaddr *) &addr, &size) == sizeof (ack))
+            {
+                sync_follower& f = sync_acked[sync_key(addr)];
+
+                if (f.frame == 0 || int(ack - f.frame) > 0)
+                    f.frame = ack;
+            }
+            FD_ZERO(&fds);
+            FD_SET(sync_sock, &fds);
+        }
+
+        // Report followers that fall behind, and those that catch up.
+
+        for (sync_follower_i i = sync_acked.begin(); i != sync_acked.end(); ++i)
+        {
+            const bool late = int(sync_frame - i->second.frame) > sync_lag;
+
+            if (late != i->second.late)
+            {
+                scm_log("panoptic sync follower %llx %s at frame %u of %u",
+                        (unsigned long long) i->first,
+                        late ? "behind" : "caught up",
+                        i->second.frame, sync_frame);
+
+                i->second.late = late;
+            }
+        }
+    }
+}
+
+void panoptic::sync_recv()
+{
+    if (sync_sock != INVALID_SOCKET && sync_follow)
+    {
+        fd_set         fds;
+        struct timeval tv = { 0, 0 };
+        sync_message   m;
+        sync_message   n;
+        sockaddr_in    addr;
+        socklen_t      size = sizeof (sockaddr_in);
+        bool           got  = false;
+
+        // Drain the socket, keeping only the newest state.
+
+        FD_ZERO(&fds);
+        FD_SET(sync_sock, &fds);
+
+        while (select(int(sync_sock) + 1, &fds, 0, 0, &tv) > 0)
+        {
+            if (recvfrom(sync_sock, (char *) &n, sizeof (n), 0,
+                         (sockaddr *) &addr, &size) == sizeof (n))
+            {
+                if (!got || n.session != m.session
+                         || int(n.frame - m.frame) > 0)
+                {
+                    m   = n;
+                    got = true;
+                }
+            }
+            FD_ZERO(&fds);
+            FD_SET(sync_sock, &fds);
+        }
+
+        // Apply it and acknowledge its frame number, ignoring stale frames of
+        // the current session.
+
+        if (got && (m.session != sync_session || int(m.frame - sync_frame) > 0))
+        {
+            double q[4];
+            double p[3];
+            double l[3];
+
+            for (int i = 0; i < 4; i++) q[i] = m.q[i] / 32767.0;
+            for (int i = 0; i < 3; i++) p[i] = m.p[i] / 2147483647.0;
+            for (int i = 0; i < 3; i++) l[i] = m.l[i] / 32767.0;
+
+            sync_normalize(q, 4);
+            sync_normalize(p, 3);
+            sync_normalize(l, 3);
+
+            for (int i = 0; i < 4; i++)
+                m.s[i][31] = 0;
+
+            here.set_foreground0(sync_get(here.get_foreground0(), m.s[0]));
+            here.set_foreground1(sync_get(here.get_foreground1(), m.s[1]));
+            here.set_background0(sync_get(here.get_background0(), m.s[2]));
+            here.set_background1(sync_get(here.get_background1(), m.s[3]));
+            here.set_orientation(q);
+            here.set_position   (p);
+            here.set_light      (l);
+            here.set_distance   (m.distance);
+            here.set_zoom       (m.zoom);
+            here.set_fade       (m.fade);
+
+            zoom         = m.view_zoom;
+            sync_session = m.session;
+            sync_frame   = m.frame;
+
+            sendto(sync_sock, (const char *) &m.frame, sizeof (m.frame), 0,
+                   (const sockaddr *) &addr, sizeof (sockaddr_in));
+        }
+    }
+}
+
+// Copy the name of scene f into a sync message. A name too long for the message
+// would not resolve on the followers, so it is sent empty and reported once.
+
+void panoptic::sync_put(char *s, const scm_scene *f)
+{
+    if (f)
+    {
+        const std::string& name = f->get_name();
+
+        if (name.size() < 32)
+            strcpy(s, name.c_str());
+
+        else if (name != sync_long)
+        {
+            scm_log("panoptic sync scene name too long: %s", name.c_str());
+            sync_long = name;
+        }
+    }
+}
+
+// Return the scene named in a sync message. Scene f is kept if it already has
+// that name, so that a follower looks up scenes only when the master changes
+// them. Comparing against the scene in place, rather than a stored name, stays
+// correct when a scene file load replaces the here state.
+
+scm_scene *panoptic::sync_get(scm_scene *f, const char *s)
+{
+    if (f ? f->get_name() == s : s[0] == 0)
+        return f;
+    else
+        return get_scene(s);
+}
+
+//------------------------------------------------------------------------------
+
 ogl::aabb panoptic::prep(int frusc, const app::frustum *const *frusv)
 {
     ogl::aabb aabb = view_app::prep(frusc, frusv);
     report();
+    sync_send();
 
     if (pan_mode())
         return aabb;
@@ -300,7 +612,7 @@ void panoptic::offset_position(const vec3 &d)
             // Clamp the altitude.
 
             here.set_distance(std::max(d[1] * k + r,
-                                    minimum_agl + here.get_current_ground()));
+                                    minimum_agl + get_current_ground()));
         }
 
         // Set the automatic view pitch if requested.
@@ -358,21 +670,30 @@ void panoptic::fade_to(int i)
 
 void panoptic::move_to(int i)
 {
-    // Construct a path from here to there.
+    // Set the destination. Cycle the selected location queue.
 
-    if (!play && 0 <= i && i < max_location && !location[i].empty())
+    if (!play && !path_active && 0 <= i && i < max_location
+                                       && !location[i].empty())
     {
-        // Set the location and destination. Cycle the selected location queue.
+        scm_state dst = get_location(i);
 
-        scm_state src = here;
-        scm_state dst = location[i].front();
+        next_location(i);
+
+        fly_to(dst);
+    }
+}
+
+void panoptic::fly_to(const scm_state& dst)
+{
+    // Construct a path from here to there.
 
-        location[i].pop_front();
-        location[i].push_back(dst);
+    if (!play && !path_active)
+    {
+        scm_state src = here;
 
         // Determine the beginning and ending positions and altitudes.
 
-        double g0 = src.get_current_ground();
+        double g0 =     get_current_ground();
         double g1 = dst.get_current_ground();
 
         double d0 = src.get_distance();
@@ -393,54 +714,105 @@ void panoptic::move_to(int i)
         // Calculate a "hump" for a low orbit path.
 
         double aa = std::min(d0 - g0, d1 - g1);
-        double dd = lg ? log10(lg / aa) * lg / 10 : 0;
 
-        // Enqueue the path.
+        path_src    = src;
+        path_dst    = dst;
+        path_hump   = lg ? log10(lg / aa) * lg / 10 : 0;
+        path_step   = 0;
+        path_length = 0;
+        path_index  = 0;
 
-        sequence.clear();
+        // Tabulate the number of steps taken to reach each parameter value.
+        // The path moves at a velocity proportional to its altitude, so the
+        // step rate is the path speed divided by the altitude. Velocity is
+        // evaluated once per table entry rather than once per step.
+
+        path_table[0] = 0;
 
         if (lo > 0)
         {
-            for (double t = 0.0; t < 1.0; )
-            {
-                double dt = 0.01;
-                double q = 4 * t - 4 * t * t;
+            const double dt = 0.01;
 
-                // Estimate the current velocity.
+            double v0 = 0;
+
+            for (int i = 0; i <= path_size; i++)
+            {
+                const double t = double(i) / path_size;
+                const double q = path_hump * (4 * t - 4 * t * t);
 
                 scm_state t0(src, dst, t);
                 scm_state t1(src, dst, t + dt);
 
-                t0.set_distance(t0.get_distance() + dd * q);
-                t1.set_distance(t1.get_distance() + dd * q);
-
-                // Queue this step.
-
-                if (auto_pitch) set_pitch(t0);
-
-                sequence.push_back(t0);
-
-                // Move forward at a velocity appropriate for the altitude.
+                t0.set_distance(t0.get_distance() + q);
+                t1.set_distance(t1.get_distance() + q);
 
                 double g = t0.get_minimum_ground();
+                double v = (t1 - t0) / (2 * (t0.get_distance() - g) * dt * dt);
 
-                t += 2 * (t0.get_distance() - g) * dt * dt / (t1 - t0);
+                if (i) path_table[i] = path_table[i - 1]
+                                     + (v0 + v) / (2 * path_size);
+                v0 = v;
             }
+            path_length = path_table[path_size];
         }
 
-        sequence.push_back(dst);
+        path_active = true;
+    }
+}
 
-        // Program the scene fade.
+// Evaluate the move path at parameter t.
 
-        const int n = int(sequence.size());
+scm_state panoptic::path_state(double t) const
+{
+    scm_state s(path_src, path_dst, t);
 
-        for (int i = 0; i <= n - 2; i++)
-            sequence[i].set_fade(hermite(double(i) / double(n - 2)));
+    s.set_distance(s.get_distance() + path_hump * (4 * t - 4 * t * t));
 
-        // Trigger playback.
+    if (auto_pitch) set_pitch(s);
 
-        play_path(false);
+    return s;
+}
+
+// Produce the next state of the move path, returning false at its end.
+
+bool panoptic::path_next(scm_state& s)
+{
+    if (path_step >= path_length)
+    {
+        s           = path_dst;
+        path_active = false;
+        return false;
     }
+
+    // Invert the step table to find the parameter value of this step.
+
+    const double k = path_step;
+
+    while (path_index < path_size - 1 && path_table[path_index + 1] < k)
+        path_index++;
+
+    const double k0 = path_table[path_index];
+    const double k1 = path_table[path_index + 1];
+    const double t  = (path_index + (k1 > k0 ? (k - k0) / (k1 - k0) : 0))
+                    / path_size;
+
+    s = path_state(std::min(t, 1.0));
+    s.set_fade(hermite(path_step / path_length));
+
+    path_step += 1;
+
+    return true;
+}
+
+void panoptic::cancel()
+{
+    path_active = false;
+    view_app::cancel();
+}
+
+bool panoptic::scripted() const
+{
+    return path_active || view_app::scripted();
 }
 
 //------------------------------------------------------------------------------
@@ -452,6 +824,11 @@ bool panoptic::process_tick(app::event *E)
 
     view_app::process_tick(E);
 
+    // Continue any move in progress.
+
+    if (path_active)
+        path_next(here);
+
     // If the demo delay timer has expired, demo.
 
     if (demo_delay > 0 && t > 0)
@@ -515,6 +892,11 @@ bool panoptic::process_tick(app::event *E)
         demo_dist_delay = 0;
         demo_turn_delay = 0;
     }
+
+    // A follower's state is always the master's.
+
+    sync_recv();
+
     return false;
 }
 
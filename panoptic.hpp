@@ -13,6 +13,7 @@
 #ifndef PANOPTIC_HPP
 #define PANOPTIC_HPP
 
+#include <map>
 #include <vector>
 
 #include <app-prog.hpp>
@@ -35,6 +36,9 @@ public:
     virtual void move_to(int);
     virtual void jump_to(int);
     virtual void fade_to(int);
+    virtual void fly_to(const scm_state&);
+    virtual void cancel();
+    virtual bool scripted() const;
 
     virtual quat get_orientation() const;
     virtual void set_orientation(const quat&);
@@ -75,11 +79,53 @@ private:
     double demo_turn_delay;
     double demo_turn_value;
 
+    // Move path generator
+
+    static const int path_size = 256;
+
+    bool      path_active;
+    scm_state path_src;
+    scm_state path_dst;
+    double    path_hump;
+    double    path_step;
+    double    path_length;
+    double    path_table[path_size + 1];
+    int       path_index;
+
+    scm_state path_state(double) const;
+    bool      path_next(scm_state&);
+
     // Report stream configuration
 
     sockaddr_in report_addr;
     SOCKET      report_sock;
     void        report();
+
+    // State synchronization
+
+    struct sync_follower
+    {
+        sync_follower() : frame(0), late(false) { }
+
+        unsigned int frame;
+        bool         late;
+    };
+
+    typedef std::map<unsigned long long, sync_follower> sync_follower_m;
+    typedef sync_follower_m::iterator                    sync_follower_i;
+
+    std::vector<sockaddr_in> sync_addr;
+    SOCKET                   sync_sock;
+    bool                     sync_follow;
+    int                      sync_lag;
+    unsigned int             sync_session;
+    unsigned int             sync_frame;
+    sync_follower_m          sync_acked;
+    std::string              sync_long;
+    void                     sync_send();
+    void                     sync_recv();
+    void                     sync_put(char *, const scm_scene *);
+    scm_scene               *sync_get(scm_scene *, const char *);
 };
 
 //-----------------------------------------------------------------------------
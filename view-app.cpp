@@ -15,6 +15,9 @@
 #include <iomanip>
 #include <sstream>
 
+#include <SDL_timer.h>
+#include <SDL_cpuinfo.h>
+
 #include <ogl-opengl.hpp>
 
 #include <etc-log.hpp>
@@ -31,30 +34,107 @@
 
 #include <util3d/math3d.h>
 #include <scm-cache.hpp>
+#include <scm-log.hpp>
 
 #include "view-app.hpp"
 
 //------------------------------------------------------------------------------
 
+// Return the time in seconds from an arbitrary origin.
+
+static double now()
+{
+    return double(SDL_GetPerformanceCounter())
+         / double(SDL_GetPerformanceFrequency());
+}
+
 view_app::view_app(const std::string& exe,
                    const std::string& tag) : app::prog(exe, tag),
     record(false),
     play  (false),
 
+    tour_index(-1),
+    tour_play (false),
+    tour_pos  (0.0),
+    tour_wait (0.0),
+
+    fade_wait (false),
+    fade_play (false),
+    fade_clock(0.0),
+    fade_count(0),
+    fade_sum  (0),
+    fade_frame(0),
+    fade_color(0),
+    fade_depth(0),
+    fade_pixel(0),
+    fade_read (false),
+
     zoom     ( 0.0),
     zoom_min (-3.0),                    // How far can we zoom in
     zoom_max ( 2.0),                    // How far can we zoom out
     zoom_rate( 0.0),
+    zoom_lead( 0.5),
+
+    motion_reset  (true),
+    motion_linear (0.0),
+    motion_angular(0.0),
+    motion        (0.0),
+    motion_climb  (0.0),
+
+    predict_wait  (false),
+    predict_clock (0.0),
+    predict_next  (0.0),
+    predict_due   (0.0),
+    predict_hits  (0),
+    predict_count (0),
+
+    latency_note  (false),
+    latency_input (0.0),
+    latency_clock (0.0),
+    latency_sum   (0.0),
+    latency_max   (0.0),
+    latency_count (0),
+
+    scene_lazy(true),
+    state_prewarm(false),
+    scene_file(0),
+    keep_gui  (false),
 
     draw_cache(false),
 
+    ground_valid(false),
+    ground_value(0.0),
+    ground_fade (0.0),
+
+    sphere_detail( 32),
+    sphere_limit (256),
+    motion_detail_value( 32),
+    motion_limit_value (256),
+
+    blur_adapt(false),
+    blur_clock(0.0),
+    blur_start(0.0),
+    blur_time (0.0),
+    blur_scale(1.0),
+
+    upload_sum  (0.0),
+    upload_peak (0.0),
+    upload_count(0),
+
     gui_index(0),
     gui_w(0),
     gui_h(0),
     gui_dx(0),
     gui_dy(0),
-    gui(0)
+    gui(0),
+    gui_tree(0),
+    gui_frame(0),
+    gui_color(0),
+    gui_dirty(true)
 {
+    ground_scene[0] = 0;
+    ground_scene[1] = 0;
+
     // Add the static data archive.
 
     extern unsigned char panoptic_data[];
@@ -63,12 +143,18 @@ view_app::view_app(const std::string& exe,
     ::data->add_pack_archive(panoptic_data,
                              panoptic_data_len);
 
-    // Configure the SCM caches.
+    // Configure the SCM caches. If view_auto_threads is set, the default
+    // loader count is half of the available processors, leaving the rest for
+    // rendering and decoding.
+
+    int threads = scm_cache::cache_threads;
+
+    if (::conf->get_i("view_auto_threads", 0))
+        threads = std::max(threads, SDL_GetCPUCount() / 2);
 
     scm_cache::cache_size      = ::conf->get_i("scm_cache_size",
                                          scm_cache::cache_size);
-    scm_cache::cache_threads   = ::conf->get_i("scm_cache_threads",
-                                         scm_cache::cache_threads);
+    scm_cache::cache_threads   = ::conf->get_i("scm_cache_threads", threads);
     scm_cache::need_queue_size = ::conf->get_i("scm_need_queue_size",
                                          scm_cache::need_queue_size);
     scm_cache::load_queue_size = ::conf->get_i("scm_load_queue_size",
@@ -76,6 +162,13 @@ view_app::view_app(const std::string& exe,
     scm_cache::loads_per_cycle = ::conf->get_i("scm_loads_per_cycle",
                                          scm_cache::loads_per_cycle);
 
+    // Configure the cache upload budget. The configured loads per cycle are
+    // the ceiling for the adaptive limit.
+
+    upload_max    = scm_cache::loads_per_cycle;
+    upload_budget = ::conf->get_f("view_upload_budget", 0.0);
+    upload_log    = ::conf->get_i("view_upload_log",    0) != 0;
+
     // Configure the keyboard interface.
 
     key_location_0 = ::conf->get_i("view_key_location_0", 39);
@@ -94,10 +187,73 @@ view_app::view_app(const std::string& exe,
     button_zoom_home = ::conf->get_i("view_button_zoom_home", 6);
     button_gui       = ::conf->get_i("view_button_gui",       7);
     button_select    = ::conf->get_i("view_button_select",    0);
+
+    // Configure the GUI.
+
+    gui_cache = ::conf->get_i("view_gui_cache", 1) != 0;
+
+    // Configure picking.
+
+    pick_step  = ::conf->get_f("view_pick_step",  0.01);
+    pick_limit = ::conf->get_i("view_pick_limit", 4096);
+
+    // Configure the motion-adaptive sphere detail.
+
+    motion_detail       = ::conf->get_i("view_motion_detail",       0) != 0;
+    motion_detail_scale = ::conf->get_f("view_motion_detail_scale", 0.5);
+    motion_limit_scale  = ::conf->get_f("view_motion_limit_scale",  2.0);
+    motion_angular_max  = ::conf->get_f("view_motion_angular",      1.0);
+    motion_linear_max   = ::conf->get_f("view_motion_linear",       1.0);
+    motion_attack       = ::conf->get_f("view_motion_attack",       0.1);
+    motion_release      = ::conf->get_f("view_motion_release",      1.0);
+
+    // Configure the motion-adaptive blur.
+
+    blur_max    = ::conf->get_i("view_blur_max",    16);
+    blur_budget = ::conf->get_f("view_blur_budget", 1.0 / 60.0);
+    blur_step   = ::conf->get_f("view_blur_step",   0.05);
+
+    // Configure scene loading.
+
+    scene_lazy    = ::conf->get_i("view_lazy_scenes",  1) != 0;
+    state_prewarm = ::conf->get_i("view_prewarm_states", 0) != 0;
+
+    // Configure tour playback and prefetching.
+
+    tour_speed      = ::conf->get_f("view_tour_speed", 0.5);
+    tour_lead       = ::conf->get_f("view_tour_lead",  2.0);
+    tour_period     = ::conf->get_f("view_tour_period", 0.25);
+    prefetch_enable = ::conf->get_i("view_prefetch",   1) != 0;
+    zoom_lead       = ::conf->get_f("view_zoom_lead",  0.5);
+
+    // Configure view prediction.
+
+    predict_enable = ::conf->get_i("view_predict",        1) != 0;
+    predict_lead   = ::conf->get_f("view_predict_lead",   1.0);
+    predict_period = ::conf->get_f("view_predict_period", 0.25);
+    predict_angle  = ::conf->get_f("view_predict_angle",  0.1);
+    predict_linear = ::conf->get_f("view_predict_linear", 0.25);
+    predict_log    = ::conf->get_i("view_predict_log",    0) != 0;
+
+    predict_lead   = std::max(0.5, std::min(predict_lead, 2.0));
+
+    // Configure latency reporting.
+
+    latency_period = ::conf->get_f("view_latency_period", 0.0);
+
+    // Configure scene fading.
+
+    fade_time    = ::conf->get_f("view_fade_time",    1.0);
+    fade_timeout = ::conf->get_f("view_fade_timeout", 5.0);
+    fade_minimum = ::conf->get_f("view_fade_minimum", 0.5);
+    fade_settle  = ::conf->get_i("view_fade_settle",  10);
+    fade_size    = ::conf->get_i("view_fade_size",    64);
 }
 
 view_app::~view_app()
 {
+    delete scene_file;
+
     ::data->free(::conf->get_s("sans_font"));
 }
 
@@ -116,9 +272,26 @@ void view_app::host_up(std::string name)
 
     sys = new scm_system(w, h, 32, 256);
 
-    // Preload data as requested.
+    // If the host is being reconfigured, reload the scene file and return to
+    // the view in effect when it went down. Otherwise, preload data as
+    // requested.
+
+    if (!scene_name.empty())
+    {
+        const bool show = keep_gui;
+
+        load_file(scene_name);
+
+        keep_here.set_foreground0(get_scene(keep_scene[0]));
+        keep_here.set_foreground1(get_scene(keep_scene[1]));
+        keep_here.set_background0(get_scene(keep_scene[2]));
+        keep_here.set_background1(get_scene(keep_scene[3]));
+
+        here = keep_here;
 
-    if (char *name = getenv("SCMINIT"))
+        if (!show) gui_hide();
+    }
+    else if (char *name = getenv("SCMINIT"))
     {
         load_file(name);
         gui_hide();
@@ -127,13 +300,50 @@ void view_app::host_up(std::string name)
         gui_show();
 }
 
-// The host is going down. Release any OpenGL context state.
+// Return the name of the given scene, or the empty string if there is none.
+
+static std::string name_of(const scm_scene *f)
+{
+    return f ? f->get_name() : std::string();
+}
+
+// The host is going down. Release any OpenGL context state. The SCM system's
+// caches and scenes live in the OpenGL context and go with it, but the scene
+// file and the view are noted, by name, so that host_up can restore them.
 
 void view_app::host_dn()
 {
+    keep_gui = (gui != 0);
+
+    if (sys)
+    {
+        keep_scene[0] = name_of(here.get_foreground0());
+        keep_scene[1] = name_of(here.get_foreground1());
+        keep_scene[2] = name_of(here.get_background0());
+        keep_scene[3] = name_of(here.get_background1());
+
+        keep_here = here;
+        keep_here.set_foreground0(0);
+        keep_here.set_foreground1(0);
+        keep_here.set_background0(0);
+        keep_here.set_background1(0);
+
+        // Release every reference to the scenes about to be deleted.
+
+        free_states();
+
+        here         = scm_state();
+        ground_valid = false;
+        motion_reset = true;
+
+        scene_keys.clear();
+    }
+
+    fade_free();
+
     delete sys;
     sys = 0;
-    gui_hide();
+    gui_reset();
 
     app::prog::host_dn();
 }
@@ -181,58 +391,171 @@ void view_app::load_images(app::node p, scm_scene *f)
     }
 }
 
-// Create a new scene object for each scene node.
+// Return a hash of the named shader source, so that an edited shader is not
+// mistaken for the one already compiled.
 
-void view_app::load_scenes(app::node p)
+static unsigned int source_hash(const std::string& name)
 {
-    for (app::node n = p.find("scene"); n; n = p.next(n, "scene"))
+    unsigned int sum = 2166136261u;
+
+    if (!name.empty())
+    {
+        if (const char *s = (const char *) ::data->load(name))
+            for (; *s; s++)
+                sum = (sum ^ (unsigned char) *s) * 16777619u;
+
+        ::data->free(name);
+    }
+    return sum;
+}
+
+// Return a string identifying the content of a scene node of a file in the
+// given directory. Scenes with equal keys are interchangeable.
+
+static std::string scene_key(app::node n, const std::string& path)
+{
+    std::ostringstream key;
+
+    key << std::setprecision(17);
+
+    key << path              << "|"
+        << n.get_s("name")   << "|" << n.get_s("label") << "|"
+        << n.get_s("vert")   << " " << source_hash(n.get_s("vert")) << "|"
+        << n.get_s("frag")   << " " << source_hash(n.get_s("frag")) << "|"
+        << n.get_i("labelr", 0x00) << " " << n.get_i("labelg", 0x00) << " "
+        << n.get_i("labelb", 0x00) << " " << n.get_i("labela", 0xFF) << " "
+        << n.get_i("clearr", 0x00) << " " << n.get_i("clearg", 0x00) << " "
+        << n.get_i("clearb", 0x00) << " " << n.get_i("cleara", 0x00) << "|";
+
+    if (app::node a = n.find("atmosphere"))
+        key << a.get_f("r", 1.0) << " " << a.get_f("g", 1.0) << " "
+            << a.get_f("b", 1.0) << " " << a.get_f("H", 0.0) << " "
+            << a.get_f("P", 1.0) << "|";
+
+    for (app::node i = n.find("image"); i; i = n.next(i, "image"))
+        key << i.get_s("name")         << " " << i.get_s("scm")         << " "
+            << i.get_i("channel", -1)  << " " << i.get_f("k0", 0.0)     << " "
+            << i.get_f("k1", 1.0)      << "|";
+
+    return key.str();
+}
+
+// Create a new scene object for the given scene node with the given key.
+
+scm_scene *view_app::load_scene(app::node n, const std::string& key)
+{
+    if (scm_scene *f = sys->get_scene(sys->add_scene(sys->get_scene_count())))
     {
-        if (scm_scene *f = sys->get_scene(sys->add_scene(sys->get_scene_count())))
+        load_images(n, f);
+
+        GLubyte labelr = n.get_i("labelr", 0x00);
+        GLubyte labelg = n.get_i("labelg", 0x00);
+        GLubyte labelb = n.get_i("labelb", 0x00);
+        GLubyte labela = n.get_i("labela", 0xFF);
+
+        GLubyte clearr = n.get_i("clearr", 0x00);
+        GLubyte clearg = n.get_i("clearg", 0x00);
+        GLubyte clearb = n.get_i("clearb", 0x00);
+        GLubyte cleara = n.get_i("cleara", 0x00);
+
+        f->set_color(labelr << 24 | labelg << 16 | labelb << 8 | labela);
+        f->set_clear(clearr << 24 | clearg << 16 | clearb << 8 | cleara);
+        f->set_name (n.get_s("name"));
+        f->set_label(n.get_s("label"));
+
+        const std::string& vert_name = n.get_s("vert");
+        const std::string& frag_name = n.get_s("frag");
+
+        if (!vert_name.empty())
+        {
+            f->set_vert((const char *) ::data->load(vert_name));
+            ::data->free(vert_name);
+        }
+        if (!vert_name.empty())
         {
-            load_images(n, f);
+            f->set_frag((const char *) ::data->load(frag_name));
+            ::data->free(frag_name);
+        }
 
-            GLubyte labelr = n.get_i("labelr", 0x00);
-            GLubyte labelg = n.get_i("labelg", 0x00);
-            GLubyte labelb = n.get_i("labelb", 0x00);
-            GLubyte labela = n.get_i("labela", 0xFF);
+        if (app::node a = n.find("atmosphere"))
+        {
+            scm_atmo atmo;
 
-            GLubyte clearr = n.get_i("clearr", 0x00);
-            GLubyte clearg = n.get_i("clearg", 0x00);
-            GLubyte clearb = n.get_i("clearb", 0x00);
-            GLubyte cleara = n.get_i("cleara", 0x00);
+            atmo.c[0] = GLfloat(a.get_f("r", 1.0));
+            atmo.c[1] = GLfloat(a.get_f("g", 1.0));
+            atmo.c[2] = GLfloat(a.get_f("b", 1.0));
+            atmo.H    = GLfloat(a.get_f("H", 0.0));
+            atmo.P    = GLfloat(a.get_f("P", 1.0));
 
-            f->set_color(labelr << 24 | labelg << 16 | labelb << 8 | labela);
-            f->set_clear(clearr << 24 | clearg << 16 | clearb << 8 | cleara);
-            f->set_name (n.get_s("name"));
-            f->set_label(n.get_s("label"));
+            f->set_atmo(atmo);
+        }
 
-            const std::string& vert_name = n.get_s("vert");
-            const std::string& frag_name = n.get_s("frag");
+        scene_keys[f] = key;
+        return f;
+    }
+    return 0;
+}
 
-            if (!vert_name.empty())
-            {
-                f->set_vert((const char *) ::data->load(vert_name));
-                ::data->free(vert_name);
-            }
-            if (!vert_name.empty())
-            {
-                f->set_frag((const char *) ::data->load(frag_name));
-                ::data->free(frag_name);
-            }
+// Register a descriptor for each scene node, keyed on its content. Shader
+// sources are read for the key here, once per load. Scenes are instantiated
+// only when first referenced, unless lazy scene loading is disabled.
 
-            if (app::node a = n.find("atmosphere"))
-            {
-                scm_atmo atmo;
+void view_app::load_scenes(app::node p)
+{
+    scene_nodes.clear();
 
-                atmo.c[0] = GLfloat(a.get_f("r", 1.0));
-                atmo.c[1] = GLfloat(a.get_f("g", 1.0));
-                atmo.c[2] = GLfloat(a.get_f("b", 1.0));
-                atmo.H    = GLfloat(a.get_f("H", 0.0));
-                atmo.P    = GLfloat(a.get_f("P", 1.0));
+    for (app::node n = p.find("scene"); n; n = p.next(n, "scene"))
+        scene_nodes.insert(std::make_pair(n.get_s("name"),
+                           view_scene_node(n, scene_key(n, scene_path))));
 
-                f->set_atmo(atmo);
-            }
+    if (!scene_lazy)
+        for (scene_node_i i = scene_nodes.begin(); i != scene_nodes.end(); ++i)
+            get_scene(i->first);
+}
+
+// Return the named scene of the current scene file, instantiating it if needed.
+// An existing scene with identical content is reused, keeping its images,
+// shaders, and cache entries warm across reloads.
+
+scm_scene *view_app::get_scene(const std::string& name)
+{
+    scene_node_i i = scene_nodes.find(name);
+
+    if (name.empty() || i == scene_nodes.end())
+        return 0;
+
+    const std::string& key = i->second.key;
+
+    for (int j = 0; j < sys->get_scene_count(); j++)
+        if (scene_keys[sys->get_scene(j)] == key)
+            return sys->get_scene(j);
+
+    // Scene images are likely in the same directory as the scene file.
+
+    if (!scene_path.empty()) sys->push_path(scene_path);
+
+    scm_scene *f = load_scene(i->second.node, key);
+
+    if (!scene_path.empty()) sys->pop_path();
+
+    return f;
+}
+
+// Delete all scenes that do not match a descriptor of the current scene file.
+
+void view_app::free_scenes()
+{
+    for (int j = 0; j < sys->get_scene_count(); )
+    {
+        scm_scene   *f = sys->get_scene(j);
+        scene_node_i i = scene_nodes.find(f->get_name());
+
+        if (i == scene_nodes.end() || i->second.key != scene_keys[f])
+        {
+            scene_keys.erase(f);
+            sys->del_scene(j);
         }
+        else j++;
     }
 }
 
@@ -267,11 +590,14 @@ void view_app::load_states(app::node p)
         l[1] = n.get_f("l1", 0.0);
         l[2] = n.get_f("l2", 1.0);
 
+        view_scenes names;
+
+        names.f0 = n.get_s("f0");
+        names.f1 = n.get_s("f1");
+        names.b0 = n.get_s("b0");
+        names.b1 = n.get_s("b1");
+
         s.set_name       (n.get_s("name"));
-        s.set_foreground0(sys->find_scene(n.get_s("f0")));
-        s.set_foreground1(sys->find_scene(n.get_s("f1")));
-        s.set_background0(sys->find_scene(n.get_s("b0")));
-        s.set_background1(sys->find_scene(n.get_s("b1")));
         s.set_orientation(q);
         s.set_position   (p);
         s.set_light      (l);
@@ -279,25 +605,132 @@ void view_app::load_states(app::node p)
         s.set_zoom       (n.get_f("z", 1.0));
         s.set_fade       (n.get_f("k", 0.0));
 
-        // Add it to one of the location queues as specified.
+        // Its scenes are instantiated when it is first used, unless states
+        // are to be pre-warmed.
+
+        if (state_prewarm)
+            resolve(s, names);
+
+        // Add it to one of the location queues as specified. A state with an
+        // index outside the queues may still serve as a tour stop by name.
 
         if (0 <= i && i < max_location)
-            location[i].push_back(s);
+        {
+            location       [i].push_back(s);
+            location_scenes[i].push_back(names);
+        }
+
+        if (!s.get_name().empty())
+            tour_states.insert(std::make_pair(s.get_name(),
+                                              view_named(s, names)));
 
         // If we don't have an initial renderable, consider this one.
 
         if (!here.renderable())
+        {
+            resolve(s, names);
             here = s;
+        }
+    }
+}
+
+// Instantiate any scenes of state s not yet instantiated.
+
+void view_app::resolve(scm_state& s, const view_scenes& names)
+{
+    if (!s.get_foreground0()) s.set_foreground0(get_scene(names.f0));
+    if (!s.get_foreground1()) s.set_foreground1(get_scene(names.f1));
+    if (!s.get_background0()) s.set_background0(get_scene(names.b0));
+    if (!s.get_background1()) s.set_background1(get_scene(names.b1));
+}
+
+// Return the state at the front of location queue i, with its scenes.
+
+scm_state view_app::get_location(int i)
+{
+    resolve(location[i].front(), location_scenes[i].front());
+    return  location[i].front();
+}
+
+// Cycle location queue i.
+
+void view_app::next_location(int i)
+{
+    location       [i].push_back(location       [i].front());
+    location_scenes[i].push_back(location_scenes[i].front());
+    location       [i].pop_front();
+    location_scenes[i].pop_front();
+}
+
+
+// Find the first state of the scene file with the given name.
+
+bool view_app::find_state(const std::string& name, scm_state& s,
+                                                  view_scenes& n) const
+{
+    view_named_c i = tour_states.find(name);
+
+    if (i != tour_states.end())
+    {
+        s = i->second.first;
+        n = i->second.second;
+        return true;
     }
+    return false;
 }
 
+// Create a new tour for each tour node, with one stop per named state.
+
+void view_app::load_tours(app::node p)
+{
+    for (app::node n = p.find("tour"); n; n = p.next(n, "tour"))
+    {
+        view_tour     t(n.get_s("name"));
+        view_scenes_v v;
+
+        for (app::node m = n.find("stop"); m; m = n.next(m, "stop"))
+        {
+            scm_state   s;
+            view_scenes k;
+
+            if (find_state(m.get_s("state"), s, k))
+            {
+                t.add(s);
+                v.push_back(k);
+            }
+        }
+
+        // Tours are initialized when played, once their scenes exist, unless
+        // states are to be pre-warmed.
+
+        if (v.size() > 1)
+        {
+            tours      .push_back(t);
+            tour_scenes.push_back(v);
+
+            if (state_prewarm)
+                play_init(int(tours.size()) - 1);
+        }
+    }
+}
 
 // Delete all states.
 
 void view_app::free_states()
 {
+    cancel();
+
+    tours.clear();
+    tour_scenes.clear();
+    tour_states.clear();
+    tour_index = -1;
+    prefetch_states.clear();
+
     for (int i = 0; i < max_location; i++)
-        location[i].clear();
+    {
+        location       [i].clear();
+        location_scenes[i].clear();
+    }
 
     sequence.clear();
 }
@@ -310,8 +743,15 @@ void view_app::unload()
 {
     free_states();
 
-    for (int i = 0; i < sys->get_scene_count(); ++i)
+    while (sys->get_scene_count())
         sys->del_scene(0);
+
+    scene_keys.clear();
+    scene_nodes.clear();
+
+    delete scene_file;
+    scene_file = 0;
+    scene_name.clear();
 }
 
 // Initialize the SCM system using the named XML file.
@@ -336,14 +776,17 @@ void view_app::load_file(const std::string& name)
 
     // If the named file exists and contains an XML sphere definition...
 
-    app::file file(name);
+    app::file *file = new app::file(name);
 
-    if (app::node root = file.get_root().find("sphere"))
+    if (app::node root = file->get_root().find("sphere"))
     {
         // Configure the sphere.
 
-        sys->get_sphere()->set_detail(root.get_i("detail", 32));
-        sys->get_sphere()->set_limit (root.get_i("limit", 256));
+        sphere_detail = root.get_i("detail", 32);
+        sphere_limit  = root.get_i("limit", 256);
+
+        sys->get_sphere()->set_detail(motion_detail_value = sphere_detail);
+        sys->get_sphere()->set_limit (motion_limit_value  = sphere_limit);
 
         // Free the states to ensure their scene references don't dangle.
 
@@ -353,26 +796,38 @@ void view_app::load_file(const std::string& name)
 
         here = scm_state();
 
-        // Load the new scenes before deleting the old scenes to ensure that
-        // common images aren't flushed and reloaded unnecessarily.
+        ground_valid = false;
 
-        int scenes = sys->get_scene_count();
+        // Register the new scenes. Scene descriptors refer to the file, so it
+        // is retained until the next load.
 
-        load_scenes(root);
+        scene_path = pushed ? path : "";
 
-        for (int i = 0; i < scenes; ++i)
-            sys->del_scene(0);
+        load_scenes(root);
 
-        // Load the states specified by the file.
+        // Load the states specified by the file. Their scenes are instantiated
+        // on first use. Only then delete the old scenes that no descriptor
+        // matches, so that common images aren't flushed and reloaded.
 
         load_states(root);
+        load_tours (root);
+        free_scenes();
 
-        // Bounce the GUI to update it with new data.
+        delete scene_file;
+        scene_file = file;
+        scene_name = name;
+        file       = 0;
 
-        gui_hide();
+        motion_reset = true;
+
+        // Rebuild the GUI to update it with new locations.
+
+        gui_reset();
         gui_show();
     }
 
+    delete file;
+
     // Pop the temporary path.
 
     if (pushed) sys->pop_path();
@@ -510,6 +965,50 @@ void view_app::play_path(bool movie)
     }
 }
 
+// Instantiate the scenes of the stops of tour i and compute its spline.
+
+void view_app::play_init(int i)
+{
+    for (int k = 0; k < tours[i].get_count(); k++)
+        resolve(tours[i].get_key(k), tour_scenes[i][k]);
+
+    tours[i].init();
+}
+
+// Start playback of the tour with the given index.
+
+void view_app::play_tour(int i)
+{
+    if (0 <= i && i < int(tours.size()))
+    {
+        cancel();
+        play_init(i);
+
+        tour_index = i;
+        tour_pos   = 0.0;
+        tour_wait  = 0.0;
+        tour_play  = true;
+    }
+}
+
+// Return true if the view is following a script rather than the user.
+
+bool view_app::scripted() const
+{
+    return play || tour_play || fade_wait || fade_play;
+}
+
+// Stop any motion in progress.
+
+void view_app::cancel()
+{
+    if (play) play_path(false);
+
+    tour_play = false;
+    fade_wait = false;
+    fade_play = false;
+}
+
 //------------------------------------------------------------------------------
 
 // Report the globe's radius at the current location. This is a sketchy hack
@@ -550,87 +1049,634 @@ void view_app::step()
 
 //------------------------------------------------------------------------------
 
-// Return the radius of the globe at the current position.
+// Return the radius of the globe at the current position. A ground query walks
+// the resident height pages, and it is made many times per frame by the speed,
+// scale, and altitude clamp computations. Memoize the answer until the view
+// moves, the scene changes, or the next frame brings newly resident pages.
 
 double view_app::get_current_ground() const
 {
-    return here.get_current_ground();
-}
+    double p[3];
 
-// Return the global minimum radius of the current SCM system.
+    here.get_position(p);
 
-double view_app::get_minimum_ground() const
-{
-    return here.get_minimum_ground();
+    if (!ground_valid || ground_p[0] != p[0]
+                      || ground_p[1] != p[1]
+                      || ground_p[2] != p[2]
+                      || ground_fade     != here.get_fade()
+                      || ground_scene[0] != here.get_foreground0()
+                      || ground_scene[1] != here.get_foreground1())
+    {
+        ground_value    = here.get_current_ground();
+        ground_fade     = here.get_fade();
+        ground_scene[0] = here.get_foreground0();
+        ground_scene[1] = here.get_foreground1();
+        ground_p[0]  = p[0];
+        ground_p[1]  = p[1];
+        ground_p[2]  = p[2];
+        ground_valid = true;
+    }
+    return ground_value;
 }
 
-//------------------------------------------------------------------------------
-
-// Prepare for rendering.
+// Sample the ground radius of the scenes of state s at each of n unit vectors
+// in v, giving the results in h. This allows a client needing many samples to
+// make a single request.
 
-ogl::aabb view_app::prep(int frusc, const app::frustum *const *frusv)
+void view_app::get_ground(const scm_state& s, int n, const double *v,
+                                                           double *h) const
 {
-    // Transfer the current camera state to the view manager.
+    scm_state t(s);
 
-    ::view->set_orientation(view_app::get_orientation());
+    for (int i = 0; i < n; i++)
+    {
+        t.set_position(v + 3 * i);
+        h[i] = t.get_current_ground();
+    }
+}
 
-    ::view->set_position(get_position());
-    ::view->set_scaling (get_scale());
+// Find the first intersection x of the world-space ray with origin p and unit
+// direction v with the displaced sphere of the here state. The surface lies
+// between the minimum ground radius and the viewer, which bounds the interval
+// to be searched. March it in batched ground queries and refine the first
+// crossing by bisection. The march step is a fraction of the viewer's altitude,
+// so terrain narrower than one step along the ray may be stepped over.
 
-    // Handle the zoom. Not all subclasses will appreciate this.
+bool view_app::pick(const vec3& p, const vec3& v, vec3& x) const
+{
+    static const int n = 64;
+    static const int m = 24;
 
-    if (frusc)
-    {
-        const mat4 V =   ::view->get_transform();
-        const mat4 P = frusv[0]->get_transform();
-        const vec4 v = transpose(P * V) * vec4(0, 0, 1, 0);
+    const double r = get_minimum_ground();
+    const double b = p * v;
+    const double c = p * p - r * r;
+    const double e = b * b - c;
 
-        sys->get_sphere()->set_zoom(v[0], v[1], v[2], pow(2.0, zoom));
-    }
+    // Bound the search by the near intersection with the minimum sphere, or by
+    // the point at which a grazing ray returns to the altitude of its origin.
 
-    // Cycle the SCM cache. This is super-important.
+    double t1;
 
-    sys->update_cache();
+    if      (e > 0 && -b - sqrt(e) > 0) t1 = -b - sqrt(e);
+    else if (b < 0)                     t1 = -2.0 * b;
+    else return false;
 
-    // Return a world-space bounding volume for the sphere. This simple default
-    // will be over-ridden by any decent subclass.
+    // Choose the step from the altitude, within limits on the sample count.
 
-    double r = 2.0 * get_minimum_ground();
+    const double a = std::max(length(p) - get_current_ground(), 1.0);
+    const double s = std::min(ceil(t1 / (a * pick_step)), double(pick_limit));
+    const int    k = std::max(n, int(s));
+    const double d = t1 / k;
 
-    return ogl::aabb(vec3(-r, -r, -r),
-                     vec3(+r, +r, +r));
-}
+    // Sample the ground beneath uniformly-spaced points along the ray, one
+    // batch at a time, and refine the first sample found beneath the ground.
 
-// Perform any pre-render lighting.
+    double u[n * 3];
+    double h[n];
+    double l[n];
 
-void view_app::lite(int frusc, const app::frustum *const *frusv)
-{
-}
+    for (int i0 = 0; i0 < k; i0 += n)
+    {
+        const int w = std::min(n, k - i0);
 
-// Render the scene.
+        for (int i = 0; i < w; i++)
+        {
+            const vec3 q = p + v * (d * (i0 + i + 1));
 
-void view_app::draw(int frusi, const app::frustum *frusp, int chani)
-{
-    mat4 P =  frusp->get_transform();
-    mat4 M = ::view->get_transform();
+            l[i] = length(q);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+            u[i * 3 + 0] = q[0] / l[i];
+            u[i * 3 + 1] = q[1] / l[i];
+            u[i * 3 + 2] = q[2] / l[i];
+        }
 
-    sys->render_sphere(&here, transpose(P), transpose(M), chani);
-}
+        get_ground(here, w, u, h);
 
-// Render the GUI and debugging overlays.
+        for (int i = 0; i < w; i++)
+            if (l[i] <= h[i])
+            {
+                double t0 = d * (i0 + i    );
+                double tt = d * (i0 + i + 1);
 
-void view_app::over(int frusi, const app::frustum *frusp, int chani)
-{
-    frusp->load_transform();
-   ::view->load_transform();
+                for (int j = 0; j < m; j++)
+                {
+                    const double t = (t0 + tt) / 2;
+                    const vec3   q = p + v * t;
+                    const double z = length(q);
+                    double       g;
 
-    if (draw_cache) sys->render_cache();
+                    u[0] = q[0] / z;
+                    u[1] = q[1] / z;
+                    u[2] = q[2] / z;
 
-    if (gui) gui_draw();
-}
+                    get_ground(here, 1, u, &g);
+
+                    if (z <= g)
+                        tt = t;
+                    else
+                        t0 = t;
+                }
+                x = p + v * tt;
+                return true;
+            }
+    }
+    return false;
+}
+
+// Return the global minimum radius of the current SCM system.
+
+double view_app::get_minimum_ground() const
+{
+    return here.get_minimum_ground();
+}
+
+//------------------------------------------------------------------------------
+
+// Estimate the linear and angular velocity of the view from the change in the
+// here state since the last tick. Linear velocity is measured in altitudes per
+// second, so that it reflects apparent motion at any scale. Teleports reset
+// the estimate rather than register as an instantaneous flight.
+
+void view_app::update_motion(double dt)
+{
+    if (motion_reset || dt <= 0.0)
+    {
+        motion_here    = here;
+        motion_reset   = false;
+        motion_linear  = 0.0;
+        motion_angular = 0.0;
+        motion_omega   = vec3();
+        motion_drift   = vec3();
+        motion_climb   = 0.0;
+        predict_wait   = false;
+        return;
+    }
+
+    double q0[4];
+    double q1[4];
+
+    motion_here.get_orientation(q0);
+           here.get_orientation(q1);
+
+    const double c = fabs(q0[0] * q1[0] + q0[1] * q1[1] +
+                          q0[2] * q1[2] + q0[3] * q1[3]);
+    const double a = here.get_distance() - get_minimum_ground();
+
+    motion_angular = 2.0 * acos(std::min(c, 1.0)) / dt;
+    motion_linear  = (a > 0.0) ? (here - motion_here) / a / dt : 0.0;
+
+    // Estimate the velocity vectors for extrapolation: the angular velocity
+    // as a world-space axis scaled by rate, the rate of change of the unit
+    // position vector, and the rate of change of log distance.
+
+    {
+        const quat d = quat(q1[0], q1[1], q1[2], q1[3])
+             * inverse(quat(q0[0], q0[1], q0[2], q0[3]));
+        const double *v = d;
+
+        const double t = (v[3] < 0) ? -1.0 : 1.0;
+        const vec3   w = vec3(v[0], v[1], v[2]) * t;
+        const double l = length(w);
+
+        double p0[3];
+        double p1[3];
+
+        motion_here.get_position(p0);
+               here.get_position(p1);
+
+        const double r0 = motion_here.get_distance();
+        const double r1 =        here.get_distance();
+
+        const double u = (l > 0.0) ? 2.0 * atan2(l, fabs(v[3])) / dt : 0.0;
+
+        const vec3 omega = (l > 0.0) ? normal(w) * u : vec3();
+        const vec3 drift = vec3(p1[0] - p0[0],
+                                p1[1] - p0[1],
+                                p1[2] - p0[2]) * (1.0 / dt);
+        const double climb = (r0 > 0.0 && r1 > 0.0) ? log(r1 / r0) / dt : 0.0;
+
+        const double k = std::min(1.0, dt / motion_attack);
+
+        motion_omega = motion_omega + (omega - motion_omega) * k;
+        motion_drift = motion_drift + (drift - motion_drift) * k;
+        motion_climb = motion_climb + (climb - motion_climb) * k;
+    }
+
+    motion_here = here;
+
+    // Filter the normalized motion, responding quickly to the onset of motion
+    // and relaxing slowly once it stops.
+
+    double k = std::max(motion_angular / motion_angular_max,
+                        motion_linear  / motion_linear_max);
+
+    k = std::min(k, 1.0);
+
+    if (k > motion)
+        motion += (k - motion) * std::min(1.0, dt / motion_attack);
+    else
+        motion += (k - motion) * std::min(1.0, dt / motion_release);
+}
+
+// Extrapolate the here state t seconds ahead along the estimated velocity.
+
+scm_state view_app::predict(double t) const
+{
+    scm_state s(here);
+
+    double p[3];
+
+    here.get_position(p);
+
+    const double a = length(motion_omega) * t;
+    const vec3   v = normal(vec3(p[0], p[1], p[2]) + motion_drift * t);
+    const double r = here.get_distance() * exp(motion_climb * t);
+
+    if (a > 0.0)
+        s.set_orientation(quat(normal(motion_omega), a)
+                        * view_app::get_orientation());
+
+    s.set_position(v);
+    s.set_distance(std::max(r, s.get_minimum_ground()));
+
+    return s;
+}
+
+// During interactive flight, periodically prefetch the pages of the view
+// predicted predict_lead seconds ahead. One prediction at a time is held until
+// it comes due and is scored as a hit if the actual view is then within the
+// configured angle and altitude-relative distance of it.
+
+void view_app::update_predict(double dt)
+{
+    predict_clock += dt;
+
+    if (predict_wait && predict_clock >= predict_due)
+    {
+        double q0[4];
+        double q1[4];
+
+        predict_state.get_orientation(q0);
+                 here.get_orientation(q1);
+
+        const double c = fabs(q0[0] * q1[0] + q0[1] * q1[1] +
+                              q0[2] * q1[2] + q0[3] * q1[3]);
+        const double a = here.get_distance() - get_minimum_ground();
+
+        const double w = 2.0 * acos(std::min(c, 1.0));
+        const double l = (a > 0.0) ? (here - predict_state) / a : 0.0;
+
+        if (w < predict_angle && l < predict_linear)
+            predict_hits++;
+
+        predict_wait = false;
+        predict_count++;
+
+        if (predict_log && predict_count == 64)
+        {
+            scm_log("view_app prediction hit rate %.1f%%",
+                    100.0 * predict_hits / predict_count);
+
+            predict_hits  = 0;
+            predict_count = 0;
+        }
+    }
+
+    // Predict only during free flight. Tours, playback, fades, and any motion
+    // scripted by a subclass know where they are going and prefetch
+    // accordingly.
+
+    if (predict_enable && motion > 0.05 && !scripted())
+    {
+        if (predict_clock >= predict_next)
+        {
+            const scm_state s = predict(predict_lead);
+
+            prefetch(s);
+
+            if (!predict_wait)
+            {
+                predict_wait  = true;
+                predict_due   = predict_clock + predict_lead;
+                predict_state = s;
+            }
+            predict_next = predict_clock + predict_period;
+        }
+    }
+}
+
+// Coarsen the sphere detail and subdivision limit in proportion to the filtered
+// view motion. Values are quantized so that the sphere geometry changes in a
+// few discrete steps rather than pulsing with every change in velocity.
+
+void view_app::update_detail()
+{
+    if (motion_detail)
+    {
+        const double k = floor(motion * 4.0 + 0.5) / 4.0;
+
+        const double d0 = sphere_detail, d1 = d0 * motion_detail_scale;
+        const double l0 = sphere_limit,  l1 = l0 * motion_limit_scale;
+
+        int d = toint(mix(d0, d1, k));
+        int l = toint(mix(l0, l1, k));
+
+        d = std::max(d, 4);
+        l = std::max(l, 1);
+
+        if (d != motion_detail_value)
+            sys->get_sphere()->set_detail(motion_detail_value = d);
+        if (l != motion_limit_value)
+            sys->get_sphere()->set_limit (motion_limit_value  = l);
+    }
+}
+
+// Choose the motion blur sample count from the on-screen motion of the view:
+// the number of pixels that the view sweeps across in one frame, limited to
+// blur_max. If the render time of the last frame exceeds the budget, the limit
+// is scaled down, and it recovers at the same rate once the render time falls
+// below half the budget. The render time runs from prep to the last overlay,
+// so the wait for the buffer swap does not count against the budget.
+
+void view_app::update_blur(const app::frustum *frusp)
+{
+    const double t = now();
+    const double dt = blur_clock ? t - blur_clock : 0.0;
+
+    blur_clock = t;
+
+    if (blur_adapt && dt > 0.0)
+    {
+        if (blur_budget > 0.0)
+        {
+            if      (blur_time > blur_budget)
+                blur_scale = std::max(0.0, blur_scale - blur_step);
+            else if (blur_time < blur_budget / 2)
+                blur_scale = std::min(1.0, blur_scale + blur_step);
+        }
+
+        const mat4   P = frusp->get_transform();
+        const double k = 0.5 * ::host->get_buffer_w() * P[0][0];
+        const double w = std::max(motion_angular, motion_linear);
+        const double n = std::min(w * dt * k, blur_max * blur_scale);
+
+        const int b = (n < 2.0) ? 0 : int(ceil(n));
+
+        if (b != sys->get_render()->get_blur())
+            sys->get_render()->set_blur(b);
+    }
+}
+
+// Cycle the SCM cache, measuring the time taken. The cache uploads at most
+// loads_per_cycle pages per cycle. Adjust that limit to keep the upload time
+// within the budget, between one page and the configured maximum.
+
+void view_app::update_cache()
+{
+    const double t0 = now();
+    sys->update_cache();
+    const double t1 = now();
+
+    const double dt = t1 - t0;
+
+    if (upload_budget > 0.0)
+    {
+        int& n = scm_cache::loads_per_cycle;
+
+        if      (dt > upload_budget)     n = std::max(n / 2, 1);
+        else if (dt < upload_budget / 2) n = std::min(n + 1, upload_max);
+    }
+
+    upload_sum   += dt;
+    upload_peak   = std::max(upload_peak, dt);
+    upload_count += 1;
+
+    if (upload_log && upload_count == 256)
+    {
+        scm_log("view_app update_cache %.2f ms mean %.2f ms max %d loads",
+                1000.0 * upload_sum / upload_count,
+                1000.0 * upload_peak, scm_cache::loads_per_cycle);
+
+        upload_sum   = 0.0;
+        upload_peak  = 0.0;
+        upload_count = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Prepare for rendering.
+
+ogl::aabb view_app::prep(int frusc, const app::frustum *const *frusv)
+{
+    blur_start = now();
+
+    // Transfer the current camera state to the view manager.
+
+    ::view->set_orientation(view_app::get_orientation());
+
+    ::view->set_position(get_position());
+    ::view->set_scaling (get_scale());
+
+    // Handle the zoom. Not all subclasses will appreciate this.
+
+    if (frusc)
+    {
+        const mat4 V =   ::view->get_transform();
+        const mat4 P = frusv[0]->get_transform();
+        const vec4 v = transpose(P * V) * vec4(0, 0, 1, 0);
+
+        zoom_v = vec3(v[0], v[1], v[2]);
+
+        sys->get_sphere()->set_zoom(zoom_v[0],
+                                    zoom_v[1],
+                                    zoom_v[2], pow(2.0, zoom));
+    }
+
+    // Request the pages of any views queued for prefetch, using this frame's
+    // zoom vector.
+
+    prefetch_render(frusc, frusv);
+
+    // Measure input latency at the first draw of this frame.
+
+    latency_note = true;
+
+    // Adapt the sphere detail and motion blur to the current view motion.
+
+    update_detail();
+
+    if (frusc) update_blur(frusv[0]);
+
+    // Cycle the SCM cache. This is super-important.
+
+    update_cache();
+
+    // Newly resident pages may refine the ground height.
+
+    ground_valid = false;
+
+    // Return a world-space bounding volume for the sphere. This simple default
+    // will be over-ridden by any decent subclass.
+
+    double r = 2.0 * get_minimum_ground();
+
+    return ogl::aabb(vec3(-r, -r, -r),
+                     vec3(+r, +r, +r));
+}
+
+// Request that the pages visible from the given state be loaded. The request
+// is fulfilled at the start of the next prep.
+
+void view_app::prefetch(const scm_state& s)
+{
+    if (prefetch_enable)
+        prefetch_states.push_back(s);
+}
+
+// Render the sphere as seen from each state queued for prefetch, and at the
+// zoom being approached, with color and depth writes disabled. SCM requests the
+// pages these views need, without them appearing on screen. This happens at the
+// start of prep, after the previous frame's visible draws have queued their
+// requests, so that speculative requests never displace visible ones from the
+// bounded need queue.
+
+void view_app::prefetch_render(int frusc, const app::frustum *const *frusv)
+{
+    // While the zoom is under way, prefetch the pages of the here state as
+    // seen at the magnification it is heading toward.
+
+    const double z = std::max(zoom_min, std::min(zoom + zoom_rate * zoom_lead,
+                                                  zoom_max));
+
+    if (frusc && prefetch_enable && z != zoom)
+    {
+        const mat4 P =  frusv[0]->get_transform();
+        const mat4 M = ::view->get_transform();
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+
+        scm_sphere *sphere = sys->get_sphere();
+
+        sphere->set_zoom(zoom_v[0], zoom_v[1], zoom_v[2], pow(2.0, z));
+        sys->render_sphere(&here, transpose(P), transpose(M), 0);
+        sphere->set_zoom(zoom_v[0], zoom_v[1], zoom_v[2], pow(2.0, zoom));
+
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // Probe a pending fade destination.
+
+    if (frusc && fade_wait)
+        fade_probe(frusv[0]);
+
+    if (frusc && !prefetch_states.empty())
+    {
+        const mat4 P = frusv[0]->get_transform();
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+
+        for (scm_state_c i = prefetch_states.begin();
+                         i != prefetch_states.end(); ++i)
+        {
+            double q[4];
+            double p[3];
+            double r = i->get_distance();
+
+            i->get_orientation(q);
+            i->get_position   (p);
+
+            ::view->set_orientation(quat(q[0], q[1], q[2], q[3]));
+            ::view->set_position   (vec3(p[0], p[1], p[2]) * r);
+
+            const mat4 M = ::view->get_transform();
+
+            sys->render_sphere(&(*i), transpose(P), transpose(M), 0);
+        }
+
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // Restore the view of the here state.
+
+        ::view->set_orientation(view_app::get_orientation());
+        ::view->set_position   (get_position());
+    }
+    prefetch_states.clear();
+}
+
+// Perform any pre-render lighting.
+
+void view_app::lite(int frusc, const app::frustum *const *frusv)
+{
+}
+
+// Note the time elapsed between the earliest input not yet seen by a draw and
+// the first draw of the frame that reflects it.
+
+void view_app::update_latency()
+{
+    const double t = now();
+
+    if (latency_input > 0.0)
+    {
+        const double d = t - latency_input;
+
+        latency_sum  += d;
+        latency_max   = std::max(latency_max, d);
+        latency_count += 1;
+        latency_input = 0.0;
+    }
+
+    if (latency_period > 0.0 && t - latency_clock > latency_period)
+    {
+        if (latency_count)
+            scm_log("view_app input latency %.2f ms mean %.2f ms max",
+                    1000.0 * latency_sum / latency_count,
+                    1000.0 * latency_max);
+
+        latency_clock = t;
+        latency_sum   = 0.0;
+        latency_max   = 0.0;
+        latency_count = 0;
+    }
+}
+
+// Render the scene.
+
+void view_app::draw(int frusi, const app::frustum *frusp, int chani)
+{
+    if (latency_note)
+    {
+        update_latency();
+        latency_note = false;
+    }
+
+    mat4 P =  frusp->get_transform();
+    mat4 M = ::view->get_transform();
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    sys->render_sphere(&here, transpose(P), transpose(M), chani);
+}
+
+// Render the GUI and debugging overlays.
+
+void view_app::over(int frusi, const app::frustum *frusp, int chani)
+{
+    frusp->load_transform();
+   ::view->load_transform();
+
+    if (draw_cache) sys->render_cache();
+
+    if (gui) gui_draw();
+
+    blur_time = now() - blur_start;
+}
 
 //------------------------------------------------------------------------------
 
@@ -649,28 +1695,275 @@ void view_app::jump_to(int i)
 {
     if (0 <= i && i < max_location && !location[i].empty())
     {
-        here = location[i].front();
+        here = get_location(i);
+
+        next_location(i);
 
-        location[i].pop_front();
-        location[i].push_back(here);
+        motion_reset = true;
+        fade_wait    = false;
+        fade_play    = false;
+    }
+}
+
+// Travel to the given state. The default is to teleport.
+
+void view_app::fly_to(const scm_state& s)
+{
+    here = s;
+    motion_reset = true;
+}
+
+// Pick the point beneath the mouse pointer and fly to it, keeping the current
+// heading and pitch relative to the ground and approaching to an altitude no
+// greater than half the distance to the point.
+
+void view_app::pick_fly()
+{
+    const mat4 I = inverse(::view->get_transform());
+    const vec3 z = zvector(mat3(point_q));
+    const vec4 P = I * vec4(point_p[0], point_p[1], point_p[2], 1.0);
+    const vec4 V = I * vec4(-z[0], -z[1], -z[2], 0.0);
+
+    const vec3 p =        vec3(P[0], P[1], P[2]) * (1.0 / P[3]);
+    const vec3 v = normal(vec3(V[0], V[1], V[2]));
+
+    vec3 x;
+
+    if (pick(p, v, x))
+    {
+        const vec3   p0 = normal(get_position());
+        const vec3   p1 = normal(x);
+        const vec3   a  = cross(p0, p1);
+        const double g  = get_current_ground();
+
+        scm_state dst = here;
+
+        if (length(a) > 0.0)
+        {
+            const mat4 R(mat3(quat(normal(a), acos(std::min(1.0, p0 * p1)))));
+
+            dst.transform_orientation(transpose(R));
+            dst.transform_position   (transpose(R));
+            dst.transform_light      (transpose(R));
+        }
+
+        double u[3] = { p1[0], p1[1], p1[2] };
+        double h;
+
+        get_ground(here, 1, u, &h);
+
+        dst.set_distance(h + std::min(here.get_distance() - g,
+                                      length(x - p) / 2.0));
+        fly_to(dst);
+    }
+}
+
+// Render the pending fade destination into a small offscreen buffer and read it
+// back. The render requests the destination's pages, as a prefetch would, and
+// the checksum of the result tells whether any of them arrived since the last
+// probe. Page selection follows the size of the SCM system, not the viewport,
+// so the small buffer still requests full-resolution pages. The read goes to a
+// pixel buffer and is hashed at the next probe, so it never stalls the GPU.
+
+void view_app::fade_probe(const app::frustum *frusp)
+{
+    GLint frame;
+    GLint viewport[4];
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame);
+    glGetIntegerv(GL_VIEWPORT,             viewport);
+
+    if (fade_frame == 0)
+    {
+        glGenTextures     (1, &fade_color);
+        glBindTexture     (GL_TEXTURE_2D, fade_color);
+        glTexImage2D      (GL_TEXTURE_2D, 0, GL_RGBA8, fade_size, fade_size, 0,
+                           GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindTexture     (GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &fade_depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, fade_depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                              fade_size, fade_size);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers (1, &fade_frame);
+        glBindFramebuffer (GL_FRAMEBUFFER, fade_frame);
+        glFramebufferTexture2D   (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  GL_TEXTURE_2D, fade_color, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, fade_depth);
+
+        glGenBuffers(1, &fade_pixel);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, fade_pixel);
+        glBufferData(GL_PIXEL_PACK_BUFFER, fade_size * fade_size * 4, 0,
+                     GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, fade_frame);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        double q[4];
+        double p[3];
+        double r = fade_src.get_distance();
+
+        fade_src.get_orientation(q);
+        fade_src.get_position   (p);
+
+        ::view->set_orientation(quat(q[0], q[1], q[2], q[3]));
+        ::view->set_position   (vec3(p[0], p[1], p[2]) * r);
+
+        const mat4 P =  frusp->get_transform();
+        const mat4 M = ::view->get_transform();
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, fade_pixel);
+
+        // Hash the previous probe's result and compare it with the last.
+
+        if (fade_read)
+        {
+            const GLubyte *pixels = (const GLubyte *)
+                                    glMapBuffer(GL_PIXEL_PACK_BUFFER,
+                                                GL_READ_ONLY);
+            if (pixels)
+            {
+                unsigned int sum = 2166136261u;
+
+                for (int i = 0; i < fade_size * fade_size * 4; i++)
+                    sum = (sum ^ pixels[i]) * 16777619u;
+
+                if (sum == fade_sum)
+                    fade_count++;
+                else
+                    fade_count = 0;
+
+                fade_sum = sum;
+
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+        }
+
+        // Render this probe and begin its read.
+
+        glViewport(0, 0, fade_size, fade_size);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        sys->render_sphere(&fade_src, transpose(P), transpose(M), 0);
+
+        glReadPixels(0, 0, fade_size, fade_size, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        fade_read = true;
+
+        ::view->set_orientation(view_app::get_orientation());
+        ::view->set_position   (get_position());
+    }
+    else fade_count = fade_settle;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(frame));
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Release the fade probe buffer.
+
+void view_app::fade_free()
+{
+    if (fade_frame)
+    {
+        glDeleteFramebuffers (1, &fade_frame);
+        glDeleteRenderbuffers(1, &fade_depth);
+        glDeleteTextures     (1, &fade_color);
+        glDeleteBuffers      (1, &fade_pixel);
+
+        fade_frame = 0;
+        fade_depth = 0;
+        fade_color = 0;
+        fade_pixel = 0;
+        fade_read  = false;
     }
 }
 
 // Construct a fade from here to the location with the given given index. Do so
-// without moving the view.
+// without moving the view. The fade waits for the pages of the destination to
+// arrive before it begins, so that the new scene does not appear at its
+// coarsest level of detail.
 
 void view_app::fade_to(int i)
 {
-    // TODO: Plan a sequence to fade over time.
-
     if (0 <= i && i < max_location && !location[i].empty())
     {
-        scm_state there = location[i].front();
+        fade_dst = get_location(i);
+
+        // Settle here on whichever scenes currently dominate.
+
+        if (here.get_fade() > 0.5)
+        {
+            here.set_foreground0(here.get_foreground1());
+            here.set_background0(here.get_background1());
+        }
+        here.set_fade(0.0);
+
+        // Prefetch a view of the destination scenes until they are ready. The
+        // view is held where it is now, so that the probe changes only as the
+        // destination's pages arrive, even if the camera moves meanwhile.
+
+        fade_src = here;
+        fade_src.set_foreground0(fade_dst.get_foreground0());
+        fade_src.set_background0(fade_dst.get_background0());
+
+        fade_wait   = true;
+        fade_play   = false;
+        fade_clock  = 0.0;
+        fade_count  = 0;
+        fade_sum    = 0;
+        fade_read   = false;
+    }
+}
+
+// Advance the fade schedule. SCM does not report page residency, so the wait
+// watches the destination as rendered by fade_probe. It is considered resident
+// once a minimum time has passed and the rendering has not changed, meaning no
+// page of any image has arrived, for a number of consecutive frames. The
+// timeout bounds the wait regardless.
+
+void view_app::update_fade(double dt)
+{
+    fade_clock += dt;
+
+    if (fade_wait)
+    {
+        if ((fade_clock >= fade_minimum && fade_count >= fade_settle)
+                                        || fade_clock >= fade_timeout)
+        {
+            here.set_foreground1(fade_dst.get_foreground0());
+            here.set_background1(fade_dst.get_background0());
 
-        here.set_foreground0(there.get_foreground0());
-        here.set_foreground1(there.get_foreground1());
-        here.set_background0(there.get_background0());
-        here.set_background1(there.get_background1());
+            fade_wait  = false;
+            fade_play  = true;
+            fade_clock = 0.0;
+        }
+    }
+
+    if (fade_play)
+    {
+        if (fade_clock < fade_time)
+            here.set_fade(hermite(fade_clock / fade_time));
+        else
+        {
+            here.set_foreground0(fade_dst.get_foreground0());
+            here.set_foreground1(fade_dst.get_foreground1());
+            here.set_background0(fade_dst.get_background0());
+            here.set_background1(fade_dst.get_background1());
+            here.set_fade       (fade_dst.get_fade());
+
+            fade_play = false;
+        }
     }
 }
 
@@ -707,9 +2000,11 @@ bool view_app::process_function(int k, bool c, bool s)
             ren->set_wire(!ren->get_wire());
             return true;
 
-        case SDL_SCANCODE_F3: // Toggle the motion blur
+        case SDL_SCANCODE_F3: // Toggle the motion-adaptive blur
 
-            ren->set_blur(ren->get_blur() ? 0 : 16);
+            blur_adapt = !blur_adapt;
+            blur_scale = 1.0;
+            ren->set_blur(0);
             return true;
 
         case SDL_SCANCODE_F4: // Toggle the cache view
@@ -740,6 +2035,14 @@ bool view_app::process_function(int k, bool c, bool s)
             play_path(s);
             return true;
 
+        case SDL_SCANCODE_F9: // Play the next tour
+
+            if (tour_play)
+                cancel();
+            else if (!tours.empty())
+                play_tour((tour_index + 1) % int(tours.size()));
+            return true;
+
 //      case SDL_SCANCODE_F11: Default screenshot key defined by app::prog
 //      case SDL_SCANCODE_F12: Default GL flush key defined by app:prog
     }
@@ -822,6 +2125,9 @@ bool view_app::process_tick(app::event *E)
 {
     if (sys)
     {
+        update_motion (E->data.tick.dt);
+        update_predict(E->data.tick.dt);
+
         if (zoom_rate)
         {
             zoom += zoom_rate * E->data.tick.dt;
@@ -840,6 +2146,34 @@ bool view_app::process_tick(app::event *E)
             }
         }
 
+        if (fade_wait || fade_play)
+            update_fade(E->data.tick.dt);
+
+        if (tour_play)
+        {
+            const view_tour& T = tours[tour_index];
+
+            tour_pos += tour_speed * E->data.tick.dt;
+
+            if (tour_pos < T.get_length())
+            {
+                here = T.get(tour_pos);
+
+                // Prefetch the view ahead, periodically.
+
+                if ((tour_wait -= E->data.tick.dt) <= 0.0)
+                {
+                    prefetch(T.get(tour_pos + tour_speed * tour_lead));
+                    tour_wait = tour_period;
+                }
+            }
+            else
+            {
+                here = T.get(T.get_length());
+                tour_play = false;
+            }
+        }
+
         if (record)
             sequence.push_back(here);
     }
@@ -860,6 +2194,14 @@ bool view_app::process_click(app::event *E)
             return prog::process_event(E);
         }
 
+        // Fly to the point under the pointer with a middle click.
+
+        if (E->data.click.b == SDL_BUTTON_MIDDLE)
+        {
+            if (E->data.click.d) pick_fly();
+            return true;
+        }
+
         // Zoom with the mouse wheel.
 
         if (E->data.click.b == -2)
@@ -893,6 +2235,26 @@ bool view_app::process_event(app::event *E)
 {
     int e = E->get_type();
 
+    // Note the time of the earliest input awaiting a draw.
+
+    if (latency_input == 0.0 && (e == E_POINT || e == E_AXIS  ||
+                                 e == E_KEY   || e == E_CLICK ||
+                                 e == E_BUTTON))
+        latency_input = now();
+
+    // Note the mouse pointer for picking.
+
+    if (e == E_POINT && E->data.point.i == 0)
+    {
+        point_p = vec3(E->data.point.p[0],
+                       E->data.point.p[1],
+                       E->data.point.p[2]);
+        point_q = quat(E->data.point.q[0],
+                       E->data.point.q[1],
+                       E->data.point.q[2],
+                       E->data.point.q[3]);
+    }
+
     if ((e == E_KEY    && E->data.key.d
                        && E->data.key.k == SDL_SCANCODE_F1) ||
         (e == E_BUTTON && E->data.button.d
@@ -929,25 +2291,38 @@ static double deaden(double k)
     else               return 0;
 }
 
-// Initialize the file selection GUI.
+// Show the file selection GUI. The dialog is built on first use and retained
+// across show and hide, so that its directory listings are not rescanned each
+// time it appears. It is rebuilt only after gui_reset or a change of size.
 
 void view_app::gui_show()
 {
-    gui_w = ::host->get_buffer_w();
-    gui_h = ::host->get_buffer_h();
+    if (gui_tree && (gui_w != ::host->get_buffer_w() ||
+                     gui_h != ::host->get_buffer_h()))
+        gui_reset();
+
+    if (gui_tree == 0)
+    {
+        gui_w = ::host->get_buffer_w();
+        gui_h = ::host->get_buffer_h();
 
-    gui = new view_gui(this, gui_w, gui_h);
+        gui_tree = new view_gui(this, gui_w, gui_h);
 
-    if (!gui_conf.empty()) gui->set_conf(gui_conf);
-    if (!gui_data.empty()) gui->set_data(gui_data);
+        if (!gui_conf.empty()) gui_tree->set_conf(gui_conf);
+        if (!gui_data.empty()) gui_tree->set_data(gui_data);
 
-    gui->set_index(gui_index);
+        gui_tree->set_index(gui_index);
+    }
+
+    gui = gui_tree;
     gui->show();
 
+    gui_dirty = true;
+
     SDL_StartTextInput();
 }
 
-// Release the file selection GUI.
+// Hide the file selection GUI.
 
 void view_app::gui_hide()
 {
@@ -956,16 +2331,39 @@ void view_app::gui_hide()
         SDL_StopTextInput();
 
         gui->hide();
-        gui_index = gui->get_index();
-        gui_conf  = gui->get_conf();
-        gui_data  = gui->get_data();
-
-        delete gui;
         gui = 0;
     }
 }
 
-// Draw the file selection GUI in the overlay.
+// Release the file selection GUI, noting its state for the next rebuild. This
+// must happen when the location list changes or the OpenGL context goes away.
+
+void view_app::gui_reset()
+{
+    gui_hide();
+
+    if (gui_tree)
+    {
+        gui_index = gui_tree->get_index();
+        gui_conf  = gui_tree->get_conf();
+        gui_data  = gui_tree->get_data();
+
+        delete gui_tree;
+        gui_tree = 0;
+    }
+
+    if (gui_frame)
+    {
+        glDeleteFramebuffers(1, &gui_frame);
+        glDeleteTextures    (1, &gui_color);
+
+        gui_frame = 0;
+        gui_color = 0;
+    }
+}
+
+// Draw the file selection GUI in the overlay. If caching is enabled, the GUI
+// is drawn from a texture that is refreshed only when the GUI has changed.
 
 void view_app::gui_draw()
 {
@@ -987,12 +2385,124 @@ void view_app::gui_draw()
                    *       scale(vec3(w, h, 1));
 
             glLoadMatrixd(transpose(T));
-            gui->draw();
+
+            if (gui_cache && gui_dirty)
+                gui_update();
+
+            if (gui_cache)
+            {
+                glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT
+                                           | GL_TEXTURE_BIT);
+                {
+                    glUseProgram(0);
+                    glEnable(GL_TEXTURE_2D);
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                    glBindTexture(GL_TEXTURE_2D, gui_color);
+
+                    glBegin(GL_QUADS);
+                    {
+                        glTexCoord2f(0, 0); glVertex2i(0,     0);
+                        glTexCoord2f(1, 0); glVertex2i(gui_w, 0);
+                        glTexCoord2f(1, 1); glVertex2i(gui_w, gui_h);
+                        glTexCoord2f(0, 1); glVertex2i(0,     gui_h);
+                    }
+                    glEnd();
+
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                }
+                glPopAttrib();
+            }
+            else gui->draw();
         }
         glDisable(GL_DEPTH_CLAMP_NV);
     }
 }
 
+// Render the GUI to its cached texture. This happens only when an event has
+// reached the GUI, so that an open but idle dialog costs a single quad per eye.
+
+void view_app::gui_update()
+{
+    GLint frame;
+    GLint viewport[4];
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame);
+    glGetIntegerv(GL_VIEWPORT,             viewport);
+
+    if (gui_frame == 0)
+    {
+        glGenTextures(1, &gui_color);
+        glBindTexture(GL_TEXTURE_2D, gui_color);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gui_w, gui_h, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &gui_frame);
+        glBindFramebuffer(GL_FRAMEBUFFER, gui_frame);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, gui_color, 0);
+
+        // If the texture can't be rendered, draw the GUI directly instead.
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                                  != GL_FRAMEBUFFER_COMPLETE)
+        {
+            scm_log("view_app GUI framebuffer incomplete, caching disabled");
+
+            glBindFramebuffer(GL_FRAMEBUFFER, GLuint(frame));
+            glDeleteFramebuffers(1, &gui_frame);
+            glDeleteTextures    (1, &gui_color);
+
+            gui_frame = 0;
+            gui_color = 0;
+            gui_cache = false;
+            return;
+        }
+    }
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, gui_frame);
+
+    // Blend color as usual but accumulate coverage in alpha, leaving the
+    // texture premultiplied for the GL_ONE, GL_ONE_MINUS_SRC_ALPHA composite.
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_VIEWPORT_BIT);
+    {
+        glViewport(0, 0, gui_w, gui_h);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                            GL_ONE,       GL_ONE_MINUS_SRC_ALPHA);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0, gui_w, 0, gui_h, -1, +1);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        {
+            gui->draw();
+        }
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+    }
+    glPopAttrib();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(frame));
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    gui_dirty = false;
+}
+
 // Handle an event while the GUI is visible.
 
 bool view_app::gui_event(app::event *E)
@@ -1010,6 +2520,7 @@ bool view_app::gui_event(app::event *E)
                 {
                     gui->point(toint(x * gui_w),
                                toint(y * gui_h));
+                    gui_dirty = true;
                     // return true;
                 }
             }
@@ -1035,8 +2546,11 @@ bool view_app::gui_event(app::event *E)
                 double dy = copysign(pow(deaden(gui_dy), 2.0), gui_dy);
 
                 if (dx || dy)
+                {
                     gui->point(toint(gui->get_last_x() + dx * 16),
                                toint(gui->get_last_y() - dy * 16));
+                    gui_dirty = true;
+                }
             }
             return false;
 
@@ -1045,6 +2559,7 @@ bool view_app::gui_event(app::event *E)
             if (E->data.button.b == button_select)
             {
                 gui->click(0, E->data.button.d != 0);
+                gui_dirty = true;
                 return true;
             }
 
@@ -1054,16 +2569,19 @@ bool view_app::gui_event(app::event *E)
 
             if (E->data.key.d)
                 gui->key(E->data.key.k, E->data.key.m);
+            gui_dirty = true;
             return true;
 
         case E_CLICK:
 
             gui->click(E->data.click.m, E->data.click.d != 0);
+            gui_dirty = true;
             return true;
 
         case E_TEXT:
 
             gui->glyph(E->data.text.c);
+            gui_dirty = true;
             return true;
     }
     return false;
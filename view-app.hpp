@@ -13,10 +13,14 @@
 #ifndef VIEW_APP_HPP
 #define VIEW_APP_HPP
 
+#include <map>
+#include <deque>
+#include <string>
 #include <vector>
 
 #include <app-prog.hpp>
 #include <app-file.hpp>
+#include <ogl-opengl.hpp>
 
 #include <scm-system.hpp>
 #include <scm-sphere.hpp>
@@ -27,6 +31,36 @@
 #include <scm-deque.hpp>
 
 #include "view-gui.hpp"
+#include "view-tour.hpp"
+
+//-----------------------------------------------------------------------------
+
+// The names of the scenes of a state, resolved to scene objects on first use.
+
+struct view_scenes
+{
+    std::string f0;
+    std::string f1;
+    std::string b0;
+    std::string b1;
+};
+
+typedef std::deque <view_scenes> view_scenes_d;
+typedef std::vector<view_scenes> view_scenes_v;
+
+typedef std::pair<scm_state, view_scenes>   view_named;
+typedef std::map<std::string, view_named>   view_named_m;
+typedef view_named_m::const_iterator        view_named_c;
+
+// A scene descriptor of the current scene file and the key of its content.
+
+struct view_scene_node
+{
+    view_scene_node(app::node n, const std::string& k) : node(n), key(k) { }
+
+    app::node   node;
+    std::string key;
+};
 
 //-----------------------------------------------------------------------------
 
@@ -53,7 +87,9 @@ public:
     virtual void host_up(std::string);
     virtual void host_dn();
 
-    void cancel();
+    virtual void cancel();
+    virtual bool scripted() const;
+
     void flag();
     void step();
 
@@ -64,9 +100,14 @@ public:
     double get_current_ground() const;
     double get_minimum_ground() const;
 
+    void   get_ground(const scm_state&, int, const double *, double *) const;
+
+    bool   pick(const vec3&, const vec3&, vec3&) const;
+
     virtual void move_to(int);
     virtual void jump_to(int);
     virtual void fade_to(int);
+    virtual void fly_to(const scm_state&);
 
     // SCM content queries
 
@@ -84,6 +125,11 @@ protected:
     scm_state_v sequence;
     scm_deque   location[max_location];
 
+    view_scenes_d location_scenes[max_location];
+
+    scm_state get_location (int);
+    void      next_location(int);
+
     // Recording and playback
 
     bool        record;
@@ -93,12 +139,108 @@ protected:
     void import_mov(const std::string&);
     void export_mov(      std::string&);
 
+    // Tours
+
+    view_tour_v tours;
+    std::vector<view_scenes_v> tour_scenes;
+    view_named_m               tour_states;
+    int         tour_index;
+    bool        tour_play;
+    double      tour_pos;
+    double      tour_speed;
+    double      tour_lead;
+    double      tour_period;
+    double      tour_wait;
+
+    void play_tour(int);
+    void play_init(int);
+
+    // Prefetching
+
+    bool        prefetch_enable;
+    scm_state_v prefetch_states;
+
+    void prefetch(const scm_state&);
+    void prefetch_render(int, const app::frustum * const *);
+
+    // Scene fading
+
+    bool        fade_wait;
+    bool        fade_play;
+    scm_state   fade_dst;
+    scm_state   fade_src;
+    double      fade_clock;
+    int         fade_count;
+    unsigned    fade_sum;
+    double      fade_time;
+    double      fade_timeout;
+    double      fade_minimum;
+    int         fade_settle;
+    int         fade_size;
+    GLuint      fade_frame;
+    GLuint      fade_color;
+    GLuint      fade_depth;
+    GLuint      fade_pixel;
+    bool        fade_read;
+
+    void update_fade(double);
+    void fade_probe(const app::frustum *);
+    void fade_free();
+
     // Zooming
 
     double zoom;
     double zoom_min;
     double zoom_max;
     double zoom_rate;
+    double zoom_lead;
+    vec3   zoom_v;
+
+    // Motion estimation
+
+    scm_state motion_here;
+    bool      motion_reset;
+    double    motion_linear;
+    double    motion_angular;
+    double    motion;
+    vec3      motion_omega;
+    vec3      motion_drift;
+    double    motion_climb;
+
+    void update_motion(double);
+
+    // Motion prediction
+
+    bool      predict_enable;
+    bool      predict_wait;
+    bool      predict_log;
+    scm_state predict_state;
+    double    predict_clock;
+    double    predict_next;
+    double    predict_due;
+    double    predict_lead;
+    double    predict_period;
+    double    predict_angle;
+    double    predict_linear;
+    int       predict_hits;
+    int       predict_count;
+
+    scm_state predict(double) const;
+    void      update_predict(double);
+
+    // Input latency measurement
+
+    bool   latency_note;
+    double latency_input;
+    double latency_clock;
+    double latency_period;
+    double latency_sum;
+    double latency_max;
+    int    latency_count;
+
+    void update_latency();
+
+    scm_scene *get_scene(const std::string&);
 
     // Event handlers
 
@@ -110,13 +252,94 @@ protected:
 
 private:
 
-    void load_images(app::node, scm_scene *);
-    void load_scenes(app::node);
-    void load_states(app::node);
-    void free_states();
+    void       load_images(app::node, scm_scene *);
+    scm_scene *load_scene (app::node, const std::string&);
+    void       load_scenes(app::node);
+    void       free_scenes();
+    void       load_states(app::node);
+    void       load_tours (app::node);
+    bool       find_state (const std::string&, scm_state&,
+                           view_scenes&) const;
+    void       resolve    (scm_state&, const view_scenes&);
+    void       free_states();
+
+    // Scene descriptors and instances
+
+    typedef std::map<std::string, view_scene_node>::iterator scene_node_i;
+
+    bool                               scene_lazy;
+    bool                               state_prewarm;
+    app::file                         *scene_file;
+    std::string                        scene_name;
+    std::string                        scene_path;
+    std::map<std::string, view_scene_node> scene_nodes;
+    std::map<scm_scene *, std::string>     scene_keys;
+
+    // View retained across host reconfiguration
+
+    bool        keep_gui;
+    scm_state   keep_here;
+    std::string keep_scene[4];
 
     bool draw_cache;
 
+    // Pointer state for picking
+
+    vec3   point_p;
+    quat   point_q;
+    double pick_step;
+    int    pick_limit;
+
+    void pick_fly();
+
+    // Ground height cache
+
+    mutable bool       ground_valid;
+    mutable double     ground_value;
+    mutable double     ground_p[3];
+    mutable double     ground_fade;
+    mutable scm_scene *ground_scene[2];
+
+    // Motion-adaptive sphere detail
+
+    int    sphere_detail;
+    int    sphere_limit;
+    bool   motion_detail;
+    double motion_detail_scale;
+    double motion_limit_scale;
+    double motion_angular_max;
+    double motion_linear_max;
+    double motion_attack;
+    double motion_release;
+    int    motion_detail_value;
+    int    motion_limit_value;
+
+    void update_detail();
+
+    // Motion-adaptive blur
+
+    bool   blur_adapt;
+    int    blur_max;
+    double blur_budget;
+    double blur_step;
+    double blur_clock;
+    double blur_start;
+    double blur_time;
+    double blur_scale;
+
+    void update_blur(const app::frustum *);
+
+    // Cache upload budget
+
+    int    upload_max;
+    bool   upload_log;
+    double upload_budget;
+    double upload_sum;
+    double upload_peak;
+    int    upload_count;
+
+    void update_cache();
+
     bool process_function(int, bool, bool);
 
     virtual double get_speed() const { return 1.0; }
@@ -151,10 +374,17 @@ private:
     double      gui_dx;
     double      gui_dy;
     view_gui   *gui;
+    view_gui   *gui_tree;
+    bool        gui_cache;
+    GLuint      gui_frame;
+    GLuint      gui_color;
+    bool        gui_dirty;
 
     void gui_show();
     void gui_hide();
+    void gui_reset();
     void gui_draw();
+    void gui_update();
     bool gui_event(app::event *);
 };
 
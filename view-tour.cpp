@@ -0,0 +1,273 @@
+// Copyright (C) 2011-2014 Robert Kooima
+//
+// PANOPTIC is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#include <cmath>
+#include <algorithm>
+
+#include "view-tour.hpp"
+
+//------------------------------------------------------------------------------
+// Quaternion utilities. Quaternions are stored (x, y, z, w) as by scm_state.
+
+static void qmul(double *c, const double *a, const double *b)
+{
+    double t[4];
+
+    t[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+    t[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+    t[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+    t[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+
+    c[0] = t[0];
+    c[1] = t[1];
+    c[2] = t[2];
+    c[3] = t[3];
+}
+
+static void qinv(double *c, const double *a)
+{
+    c[0] = -a[0];
+    c[1] = -a[1];
+    c[2] = -a[2];
+    c[3] =  a[3];
+}
+
+static void qlog(double *c, const double *a)
+{
+    const double s = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    const double k = (s > 0) ? atan2(s, a[3]) / s : 0;
+
+    c[0] = a[0] * k;
+    c[1] = a[1] * k;
+    c[2] = a[2] * k;
+    c[3] = 0;
+}
+
+static void qexp(double *c, const double *a)
+{
+    const double t = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    const double k = (t > 0) ? sin(t) / t : 1;
+
+    c[0] = a[0] * k;
+    c[1] = a[1] * k;
+    c[2] = a[2] * k;
+    c[3] = cos(t);
+}
+
+static double qdot(const double *a, const double *b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+static void qslerp(double *c, const double *a, const double *b, double t)
+{
+    const double d = std::max(-1.0, std::min(qdot(a, b), 1.0));
+    const double w = acos(d);
+
+    double ka = 1 - t;
+    double kb =     t;
+
+    if (w > 1e-6)
+    {
+        ka = sin(ka * w) / sin(w);
+        kb = sin(kb * w) / sin(w);
+    }
+
+    c[0] = a[0] * ka + b[0] * kb;
+    c[1] = a[1] * ka + b[1] * kb;
+    c[2] = a[2] * ka + b[2] * kb;
+    c[3] = a[3] * ka + b[3] * kb;
+}
+
+// Catmull-Rom interpolation of a, b, c, d at t in [0, 1] between b and c.
+
+static double catmull(double a, double b, double c, double d, double t)
+{
+    return b + 0.5 * t * (c - a + t * (2 * a - 5 * b + 4 * c - d
+                                + t * (3 * (b - c) + d - a)));
+}
+
+//------------------------------------------------------------------------------
+
+void view_tour::add(const scm_state& k)
+{
+    keys.push_back(k);
+}
+
+// Compute the orientation spline control points and the arc-length table.
+
+void view_tour::init()
+{
+    const int n = int(keys.size());
+
+    q.resize(4 * n);
+    s.resize(4 * n);
+
+    // Gather the key orientations, each in the hemisphere of its predecessor.
+
+    for (int i = 0; i < n; i++)
+    {
+        keys[i].get_orientation(&q[4 * i]);
+
+        if (i && qdot(&q[4 * i], &q[4 * i - 4]) < 0)
+        {
+            q[4 * i + 0] = -q[4 * i + 0];
+            q[4 * i + 1] = -q[4 * i + 1];
+            q[4 * i + 2] = -q[4 * i + 2];
+            q[4 * i + 3] = -q[4 * i + 3];
+        }
+    }
+
+    // Compute the squad intermediates.
+
+    for (int i = 0; i < n; i++)
+    {
+        const double *q0 = &q[4 * std::max(i - 1, 0)];
+        const double *q1 = &q[4 * i];
+        const double *q2 = &q[4 * std::min(i + 1, n - 1)];
+
+        double a[4], b[4], c[4], d[4];
+
+        qinv(a, q1);
+        qmul(b, a, q2);
+        qmul(c, a, q0);
+        qlog(b, b);
+        qlog(c, c);
+
+        d[0] = -(b[0] + c[0]) / 4;
+        d[1] = -(b[1] + c[1]) / 4;
+        d[2] = -(b[2] + c[2]) / 4;
+        d[3] = 0;
+
+        qexp(d, d);
+        qmul(&s[4 * i], q1, d);
+    }
+
+    // Tabulate the arc length. Distance traveled is measured in altitudes so
+    // that motion near the ground counts for more than motion in orbit, and
+    // rotation is measured in radians so that panoramas have length too.
+
+    table.clear();
+    table.push_back(0);
+
+    if (n > 1)
+    {
+        scm_state a = eval(0, 0);
+
+        for (int i = 0; i < n - 1; i++)
+            for (int j = 1; j <= detail; j++)
+            {
+                scm_state b = eval(i, double(j) / detail);
+
+                double pa[3], qa[4], ra = a.get_distance();
+                double pb[3], qb[4], rb = b.get_distance();
+
+                a.get_position(pa);
+                b.get_position(pb);
+                a.get_orientation(qa);
+                b.get_orientation(qb);
+
+                const double dx = pb[0] * rb - pa[0] * ra;
+                const double dy = pb[1] * rb - pa[1] * ra;
+                const double dz = pb[2] * rb - pa[2] * ra;
+                const double h  = std::max(ra - a.get_minimum_ground(), 1.0);
+                const double w  = 2 * acos(std::min(fabs(qdot(qa, qb)), 1.0));
+
+                table.push_back(table.back()
+                                + sqrt(dx * dx + dy * dy + dz * dz) / h + w);
+                a = b;
+            }
+    }
+    length = table.back();
+}
+
+// Evaluate the spline at parameter t of segment i.
+
+scm_state view_tour::eval(int i, double t) const
+{
+    const int n = int(keys.size());
+
+    const int i0 = std::max(i - 1, 0);
+    const int i1 = i;
+    const int i2 = std::min(i + 1, n - 1);
+    const int i3 = std::min(i + 2, n - 1);
+
+    // Interpolate scenes, light, fade, and zoom linearly.
+
+    scm_state k(keys[i1], keys[i2], t);
+
+    // Interpolate position and log distance along Catmull-Rom splines.
+
+    double p0[3], p1[3], p2[3], p3[3], p[3];
+
+    keys[i0].get_position(p0);
+    keys[i1].get_position(p1);
+    keys[i2].get_position(p2);
+    keys[i3].get_position(p3);
+
+    for (int j = 0; j < 3; j++)
+        p[j] = catmull(p0[j], p1[j], p2[j], p3[j], t);
+
+    const double l = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+
+    if (l > 0)
+    {
+        p[0] /= l;
+        p[1] /= l;
+        p[2] /= l;
+        k.set_position(p);
+    }
+
+    const double r0 = keys[i0].get_distance();
+    const double r1 = keys[i1].get_distance();
+    const double r2 = keys[i2].get_distance();
+    const double r3 = keys[i3].get_distance();
+
+    if (r0 > 0 && r1 > 0 && r2 > 0 && r3 > 0)
+        k.set_distance(exp(catmull(log(r0), log(r1), log(r2), log(r3), t)));
+
+    // Interpolate orientation along the squad spline.
+
+    double a[4], b[4], c[4];
+
+    qslerp(a, &q[4 * i1], &q[4 * i2], t);
+    qslerp(b, &s[4 * i1], &s[4 * i2], t);
+    qslerp(c, a, b, 2 * t * (1 - t));
+
+    k.set_orientation(c);
+
+    return k;
+}
+
+// Return the state at arc length d along the tour.
+
+scm_state view_tour::get(double d) const
+{
+    if (table.size() < 2 || d <= 0)
+        return keys.front();
+    if (d >= length)
+        return keys.back();
+
+    const int j = int(std::upper_bound(table.begin(), table.end(), d)
+                                     - table.begin());
+
+    const double d0 = table[j - 1];
+    const double d1 = table[j];
+    const double u  = (j - 1) + ((d1 > d0) ? (d - d0) / (d1 - d0) : 0);
+
+    const int    i = std::min(int(u) / detail, int(keys.size()) - 2);
+    const double t = u / detail - i;
+
+    return eval(i, t);
+}
+
+//------------------------------------------------------------------------------
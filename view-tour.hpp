@@ -0,0 +1,62 @@
+// Copyright (C) 2011-2014 Robert Kooima
+//
+// PANOPTIC is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+// details.
+
+#ifndef VIEW_TOUR_HPP
+#define VIEW_TOUR_HPP
+
+#include <string>
+#include <vector>
+
+#include <scm-state.hpp>
+
+//------------------------------------------------------------------------------
+// A tour is a smooth path through an ordered list of states. Position and
+// distance follow Catmull-Rom splines and orientation follows a squad spline.
+// An arc-length table, measured in apparent motion, allows the tour to be
+// sampled at constant speed, one state at a time.
+
+class view_tour
+{
+public:
+
+    view_tour(const std::string& name) : name(name), length(0) { }
+
+    void add(const scm_state&);
+    void init();
+
+    scm_state get(double) const;
+
+    const std::string& get_name()   const { return name;   }
+    double             get_length() const { return length; }
+    int                get_count()  const { return int(keys.size()); }
+
+    scm_state& get_key(int i) { return keys[i]; }
+
+private:
+
+    static const int detail = 32;
+
+    std::string         name;
+    scm_state_v         keys;
+    std::vector<double> q;
+    std::vector<double> s;
+    std::vector<double> table;
+    double              length;
+
+    scm_state eval(int, double) const;
+};
+
+typedef std::vector<view_tour> view_tour_v;
+
+//------------------------------------------------------------------------------
+
+#endif